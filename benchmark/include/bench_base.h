@@ -0,0 +1,89 @@
+#ifndef BENCHMARK_INCLUDE_BENCH_BASE_H_
+#define BENCHMARK_INCLUDE_BENCH_BASE_H_
+
+#include <string>
+#include <vector>
+
+#include "tilt/base/ctype.h"
+#include "tilt/pass/codegen/vinstr.h"
+
+using namespace std;
+
+class Benchmark {
+public:
+    virtual ~Benchmark() {}
+
+    // Runs the benchmark `repeat` times and returns the mean execution time in microseconds
+    double run(int repeat = 1);
+
+protected:
+    virtual void init() {}
+    virtual void execute() = 0;
+    virtual void release() {}
+};
+
+// Runs a compiled unary query over `len` events of duration `dur`
+template<typename InTy, typename OutTy>
+class QueryBench : public Benchmark {
+public:
+    QueryBench(intptr_t addr, size_t len, int64_t dur) :
+        addr(addr), len(len), dur(dur), in_tl(len), in_data(len), out_tl(len), out_data(len)
+    {
+        tilt::init_region(&in_reg, 0, tilt::get_buf_size(len), in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+        for (size_t i = 0; i < len; i++) {
+            auto t = (i + 1) * dur;
+            tilt::commit_data(&in_reg, t);
+            auto ptr = tilt::fetch(&in_reg, t, tilt::get_end_idx(&in_reg), sizeof(InTy));
+            *reinterpret_cast<InTy*>(ptr) = static_cast<InTy>(i % 1000);
+        }
+    }
+
+private:
+    void init() final
+    {
+        tilt::init_region(&out_reg, 0, tilt::get_buf_size(len), out_tl.data(),
+            reinterpret_cast<char*>(out_data.data()));
+    }
+
+    void execute() final
+    {
+        auto loop = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) addr;
+        loop(0, len * dur, &out_reg, &in_reg);
+    }
+
+    intptr_t addr;
+    size_t len;
+    int64_t dur;
+    region_t in_reg;
+    vector<ival_t> in_tl;
+    vector<InTy> in_data;
+    region_t out_reg;
+    vector<ival_t> out_tl;
+    vector<OutTy> out_data;
+};
+
+void print_header(const string, const vector<string>);
+void print_row(const string, const vector<double>);
+
+// compile benchmarks
+void compile_bench();
+void deploy_bench();
+
+// code generation benchmarks
+void option_bench();
+void layout_bench();
+void timeline_bench();
+
+// execution benchmarks
+void advance_bench();
+void ingest_bench();
+void eventlog_bench();
+void stream_bench();
+void concurrent_bench();
+void parallel_bench();
+void keyed_bench();
+void pipeline_bench();
+void fusion_bench();
+void sliding_bench();
+
+#endif  // BENCHMARK_INCLUDE_BENCH_BASE_H_
@@ -0,0 +1,45 @@
+#include <string>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+// Samples the event active at the end of every period
+static Op _Sample(_sym in, int64_t period)
+{
+    auto e = in[_pt(0)];
+    auto e_sym = _sym("e", e);
+    auto sample_op = _op(
+        _iter(0, period),
+        Params{ in },
+        SymTable{ {e_sym, e} },
+        _exists(e_sym),
+        e_sym);
+    return sample_op;
+}
+
+void advance_bench()
+{
+    int repeat = 10;
+    size_t len = 1 << 22;
+    int64_t dur = 1;
+
+    auto in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    auto jit = ExecEngine::Get();
+
+    // Every step of the query skips `period` input events
+    print_header("advance (sample)", {"ms", "ns/output"});
+    for (int64_t period : {1, 4, 16, 256, 4096, 65536}) {
+        auto op = _Sample(in_sym, period);
+        auto loop = jit->AddQuery(_sym("bench_advance_" + to_string(period), op), op);
+        QueryBench<int32_t, int32_t> bench(jit->Lookup(loop->get_name()), len, dur);
+
+        auto time = bench.run(repeat);
+        print_row("period " + to_string(period), { time / 1000, time * 1000 / (len / period) });
+    }
+}
@@ -0,0 +1,41 @@
+#include <chrono>
+#include <cstdio>
+
+#include "bench_base.h"
+
+using namespace std::chrono;
+
+double Benchmark::run(int repeat)
+{
+    double total = 0;
+
+    for (int i = 0; i < repeat; i++) {
+        init();
+        auto start = high_resolution_clock::now();
+        execute();
+        auto end = high_resolution_clock::now();
+        release();
+
+        total += duration_cast<nanoseconds>(end - start).count() / 1000.0;
+    }
+
+    return total / repeat;
+}
+
+void print_header(const string title, const vector<string> cols)
+{
+    printf("\n%-24s", title.c_str());
+    for (const auto& col : cols) {
+        printf("%16s", col.c_str());
+    }
+    printf("\n");
+}
+
+void print_row(const string name, const vector<double> vals)
+{
+    printf("%-24s", name.c_str());
+    for (const auto& val : vals) {
+        printf("%16.2f", val);
+    }
+    printf("\n");
+}
@@ -0,0 +1,141 @@
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "tilt/pass/codegen/loopgen.h"
+#include "tilt/pass/codegen/llvmgen.h"
+#include "tilt/engine/engine.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+typedef function<Op(string)> QueryGen;
+
+class LLVMGenBench : public Benchmark {
+public:
+    LLVMGenBench(string name, QueryGen gen) : name(name), gen(gen) {}
+
+private:
+    void init() final
+    {
+        op = gen(name);
+        loop = LoopGen::Build(_sym(name, op), op.get());
+    }
+
+    void execute() final { llmod = LLVMGen::Build(loop, ExecEngine::Get()->GetCtx()); }
+
+    void release() final { llmod.reset(); }
+
+    string name;
+    QueryGen gen;
+    Op op;
+    tilt::Loop loop;
+    unique_ptr<llvm::Module> llmod;
+};
+
+class JITBench : public Benchmark {
+public:
+    JITBench(string name, QueryGen gen) : name(name), gen(gen), id(0) {}
+
+private:
+    void init() final
+    {
+        // Every run needs fresh symbol names in the JIT
+        auto query_name = name + "_" + to_string(id++);
+        op = gen(query_name);
+        loop = LoopGen::Build(_sym(query_name, op), op.get());
+    }
+
+    void execute() final
+    {
+        auto jit = ExecEngine::Get();
+        jit->AddLoop(loop);
+        jit->Lookup(loop->get_name());
+    }
+
+    string name;
+    QueryGen gen;
+    int id;
+    Op op;
+    tilt::Loop loop;
+};
+
+class DeployBench : public Benchmark {
+public:
+    DeployBench(vector<QueryGen> gens, int num_queries, unsigned threads) :
+        gens(gens), num_queries(num_queries), threads(threads), id(0)
+    {}
+
+private:
+    void init() final
+    {
+        loops.clear();
+        for (int i = 0; i < num_queries; i++) {
+            auto query_name = "bench_deploy_" + to_string(threads) + "_" + to_string(id++);
+            auto op = gens[i % gens.size()](query_name);
+            loops.push_back(LoopGen::Build(_sym(query_name, op), op.get()));
+        }
+    }
+
+    void execute() final { ExecEngine::Get()->AddLoops(loops, threads); }
+
+    vector<QueryGen> gens;
+    int num_queries;
+    unsigned threads;
+    int id;
+    vector<tilt::Loop> loops;
+};
+
+void compile_bench()
+{
+    int repeat = 50;
+
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto sel_in_sym = _sym("in", tilt::Type(types::STRUCT<float>(), _iter(0, -1)));
+    auto int_in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+
+    vector<pair<string, QueryGen>> queries = {
+        {"select", [&](string) { return _Select(sel_in_sym, [](Expr s) { return _add(s, _f32(1)); }); }},
+        {"moving_sum", [&](string) { return _MovingSum(int_in_sym, 1, 10); }},
+        {"norm", [&](string name) { return _Norm(name, in_sym, 10); }},
+        {"resample", [&](string name) { return _Resample(name, in_sym, 5, 4); }},
+    };
+
+    print_header("compile (us)", {"llvmgen", "jit"});
+    for (const auto& [name, gen] : queries) {
+        LLVMGenBench llvmgen_bench("bench_llvmgen_" + name, gen);
+        JITBench jit_bench("bench_jit_" + name, gen);
+        print_row(name, { llvmgen_bench.run(repeat), jit_bench.run(repeat) });
+    }
+}
+
+void deploy_bench()
+{
+    int repeat = 3;
+    int num_queries = 200;
+
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto sel_in_sym = _sym("in", tilt::Type(types::STRUCT<float>(), _iter(0, -1)));
+    auto int_in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+
+    vector<QueryGen> gens = {
+        [&](string) { return _Select(sel_in_sym, [](Expr s) { return _add(s, _f32(1)); }); },
+        [&](string) { return _MovingSum(int_in_sym, 1, 10); },
+        [&](string name) { return _Norm(name, in_sym, 10); },
+        [&](string name) { return _Resample(name, in_sym, 5, 4); },
+    };
+
+    // Total time to deploy all queries against the number of compile threads
+    print_header("deploy " + to_string(num_queries) + " queries (ms)", {"time"});
+    auto max_threads = max(thread::hardware_concurrency(), 1u);
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        DeployBench bench(gens, num_queries, threads);
+        print_row(to_string(threads) + " threads", { bench.run(repeat) / 1000 });
+    }
+}
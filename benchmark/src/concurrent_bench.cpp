@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+#include "tilt/engine/concurrent.h"
+#include "tilt/pass/codegen/vinstr.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+using namespace std::chrono;
+
+void concurrent_bench()
+{
+    size_t len = 1 << 22;
+    int64_t w = 10;
+
+    auto in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    auto op = _MovingSum(in_sym, 1, w);
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("bench_concurrent_moving_sum", op), op);
+    auto query = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) jit->Lookup(loop->get_name());
+
+    vector<ival_t> in_tl(len);
+    vector<int32_t> in_data(len);
+    for (size_t i = 0; i < len; i++) {
+        in_tl[i] = {static_cast<ts_t>(i), 1};
+        in_data[i] = i % 1000;
+    }
+
+    // The producer thread pushes batches as fast as the ring allows, and the
+    // consumer runs the query up to the watermark whenever it advances.
+    // Latency is the time from pushing an event to its output being written,
+    // which includes waiting in the ring, so it grows with the capacity.
+    print_header("concurrent (moving_sum)", {"Mevents/s", "mean lat (us)", "p50 lat (us)", "p99 lat (us)"});
+    for (auto [capacity, batch] : vector<pair<size_t, size_t>>{{1024, 1}, {1024, 16}, {1024, 256},
+                                                                 {65536, 16}, {65536, 256}}) {
+        ConcurrentRegion creg(sizeof(int32_t), capacity, w);
+        vector<int64_t> push_ns(len);
+
+        // Output ring that the consumer resets once it is full
+        auto out_size = get_buf_size(1 << 16);
+        region_t out_reg;
+        vector<ival_t> out_tl(out_size);
+        vector<int32_t> out_data(out_size);
+        init_region(&out_reg, 0, out_size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+
+        auto start = steady_clock::now();
+        std::thread producer([&]() {
+            for (size_t i = 0; i < len; i += batch) {
+                auto n = min(batch, len - i);
+                auto now = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+                for (size_t j = i; j < i + n; j++) {
+                    push_ns[j] = now;
+                }
+                creg.Push(&in_tl[i], reinterpret_cast<char*>(&in_data[i]), n);
+            }
+        });
+
+        vector<double> lats(len);
+        ts_t out_t = 0;
+        while (out_t < static_cast<ts_t>(len)) {
+            auto wm = creg.Watermark();
+            if (wm == out_t) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (get_end_idx(&out_reg) + (wm - out_t) >= static_cast<idx_t>(out_size)) {
+                init_region(&out_reg, out_t, out_size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+            }
+            region_t snap;
+            query(out_t, wm, &out_reg, creg.Snapshot(&snap));
+            creg.Release(wm);
+
+            auto now = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+            for (ts_t i = out_t; i < wm; i++) {
+                lats[i] = (now - push_ns[i]) / 1000.0;
+            }
+            out_t = wm;
+        }
+        auto total = duration_cast<nanoseconds>(steady_clock::now() - start).count() / 1e9;
+        producer.join();
+
+        double mean = 0;
+        for (auto lat : lats) {
+            mean += lat / lats.size();
+        }
+        std::sort(lats.begin(), lats.end());
+        auto p50 = lats[lats.size() / 2];
+        auto p99 = lats[lats.size() * 99 / 100];
+
+        print_row("cap " + to_string(capacity) + " batch " + to_string(batch), { len / total / 1e6, mean, p50, p99 });
+    }
+}
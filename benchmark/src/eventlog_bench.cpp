@@ -0,0 +1,95 @@
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+#include "tilt/engine/eventlog.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+using namespace std::chrono;
+
+static double elapsed_ms(high_resolution_clock::time_point start)
+{
+    return duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+}
+
+void eventlog_bench()
+{
+    size_t len = 1 << 24;
+    auto path = (std::filesystem::temp_directory_path() / "tilt_bench.log").string();
+
+    {
+        EventLogWriter writer(path, sizeof(int32_t));
+        vector<ival_t> tl(len);
+        vector<int32_t> data(len);
+        for (size_t i = 0; i < len; i++) {
+            tl[i] = { static_cast<ts_t>(i), 1 };
+            data[i] = i % 1000;
+        }
+        writer.Append(tl.data(), reinterpret_cast<char*>(data.data()), len);
+    }
+
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int32_t>(), _iter(0, -1)));
+    auto op = _Select(in_sym, [] (Expr s) { return _mul(s, _i32(3)); });
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("bench_eventlog_mul", op), op);
+    auto loop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) jit->Lookup(loop->get_name());
+
+    auto size = get_buf_size(len);
+    region_t out_reg;
+    vector<ival_t> out_tl(size);
+    vector<int32_t> out_data(size);
+    auto run = [&](region_t* in_reg) {
+        init_region(&out_reg, 0, size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+        auto start = high_resolution_clock::now();
+        loop_addr(0, len, &out_reg, in_reg);
+        return elapsed_ms(start);
+    };
+
+    print_header("eventlog (ms)", {"load", "query", "total"});
+
+    // Copy path: read the events and commit them one by one
+    {
+        auto start = high_resolution_clock::now();
+        EventLogHeader header;
+        auto file = fopen(path.c_str(), "rb");
+        fread(&header, sizeof(header), 1, file);
+        vector<ival_t> tl(len);
+        vector<int32_t> data(len);
+        fseek(file, header.tl_offset, SEEK_SET);
+        fread(tl.data(), sizeof(ival_t), len, file);
+        fseek(file, header.data_offset, SEEK_SET);
+        fread(data.data(), sizeof(int32_t), len, file);
+        fclose(file);
+
+        region_t in_reg;
+        vector<ival_t> in_tl(size);
+        vector<int32_t> in_data(size);
+        init_region(&in_reg, header.st, size, in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+        for (size_t i = 0; i < len; i++) {
+            auto et = tl[i].t + tl[i].d;
+            commit_data(&in_reg, et);
+            *reinterpret_cast<int32_t*>(fetch(&in_reg, et, get_end_idx(&in_reg), sizeof(int32_t))) = data[i];
+        }
+        auto load = elapsed_ms(start);
+        auto query = run(&in_reg);
+        print_row("copy", { load, query, load + query });
+    }
+
+    // Mapped path: the loop reads the file through the page cache
+    {
+        auto start = high_resolution_clock::now();
+        EventLog log(path);
+        auto load = elapsed_ms(start);
+        auto query = run(log.Region());
+        print_row("mmap", { load, query, load + query });
+    }
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,66 @@
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+#include "tilt/pass/fusion.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+void fusion_bench()
+{
+    int repeat = 10;
+    // Multiple of the window
+    size_t len = 1000000;
+    int64_t dur = 1;
+    int64_t w = 1000;
+
+    // Sum of a map over the window, a sibling map reading its output, and
+    // the count of the window, fused into one pass over the window
+    auto map_sum = [w](string name, _sym in) -> Op {
+        auto win = in[_win(-w, 0)];
+        auto win_sym = _sym("win", win);
+        auto sq = _Map(win_sym, [](Expr e) { return _mul(e, e); });
+        auto sq_sym = _sym(name + "_sq", sq);
+        auto sum = _Sum(sq_sym);
+        auto sum_sym = _sym(name + "_sum", sum);
+        auto count = _Count(win_sym);
+        auto count_sym = _sym(name + "_count", count);
+        auto mean = sum_sym / count_sym;
+        auto mean_sym = _sym("mean", mean);
+        return _op(
+            _iter(0, w),
+            Params{ in },
+            SymTable{ {win_sym, win}, {sq_sym, sq}, {sum_sym, sum}, {count_sym, count}, {mean_sym, mean} },
+            _true(),
+            mean_sym);
+    };
+
+    vector<pair<string, function<Op(string, _sym)>>> queries = {
+        {"map_sum", map_sum},
+        {"window_avg", [w](string name, _sym in) { return _WindowAvg(name, in, w); }},
+        {"norm", [w](string name, _sym in) { return _Norm(name, in, w); }},
+    };
+
+    auto jit = ExecEngine::Get();
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+
+    print_header("fusion (ms)", {"unfused", "fused"});
+    for (const auto& [name, build] : queries) {
+        // Fusion keeps symbol names, so both versions need their own
+        auto op = build("bench_unfused_" + name, in_sym);
+        auto fused_op = OpFusion::Build(build("bench_fused_" + name, in_sym));
+
+        auto loop = jit->AddQuery(_sym("bench_unfused_" + name, op), op);
+        auto fused_loop = jit->AddQuery(_sym("bench_fused_" + name, fused_op), fused_op);
+        QueryBench<float, float> bench(jit->Lookup(loop->get_name()), len, dur);
+        QueryBench<float, float> fused_bench(jit->Lookup(fused_loop->get_name()), len, dur);
+
+        print_row(name, { bench.run(repeat) / 1000, fused_bench.run(repeat) / 1000 });
+    }
+}
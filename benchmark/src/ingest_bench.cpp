@@ -0,0 +1,73 @@
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tilt/engine/ingest.h"
+
+#include "bench_base.h"
+
+using namespace tilt;
+using namespace std::chrono;
+
+namespace {
+
+struct Quote {
+    int64_t id;
+    double bid;
+    double ask;
+    int32_t bid_size;
+    int32_t ask_size;
+};
+
+// Appends `len` events to a ring of `capacity` events in batches of `batch`
+// events and returns the throughput in million events per second
+template<typename T>
+double ingest(size_t len, size_t capacity, uint32_t batch, bool bulk)
+{
+    vector<ival_t> tl(len);
+    vector<T> data(len);
+    for (size_t i = 0; i < len; i++) {
+        tl[i] = { static_cast<ts_t>(i), 1 };
+    }
+
+    auto size = get_buf_size(capacity);
+    region_t reg;
+    vector<ival_t> reg_tl(size);
+    vector<T> reg_data(size);
+    init_region(&reg, 0, size, reg_tl.data(), reinterpret_cast<char*>(reg_data.data()));
+
+    auto start = high_resolution_clock::now();
+    for (size_t i = 0; i < len; i += batch) {
+        if (bulk) {
+            commit_batch(&reg, &tl[i], reinterpret_cast<char*>(&data[i]), sizeof(T), batch);
+        } else {
+            for (size_t j = i; j < i + batch; j++) {
+                auto et = tl[j].t + tl[j].d;
+                commit_data(&reg, et);
+                auto ptr = fetch(&reg, et, get_end_idx(&reg), sizeof(T));
+                memcpy(ptr, &data[j], sizeof(T));
+            }
+        }
+    }
+    auto time = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+    return len * 1000.0 / time;
+}
+
+}  // namespace
+
+void ingest_bench()
+{
+    size_t len = 1 << 24;
+    size_t capacity = 1 << 16;
+
+    print_header("ingest (Mevents/s)", {"int32 event", "int32 batch", "quote event", "quote batch"});
+    for (uint32_t batch : {16, 256, 4096}) {
+        print_row("batch " + to_string(batch), {
+            ingest<int32_t>(len, capacity, batch, false),
+            ingest<int32_t>(len, capacity, batch, true),
+            ingest<Quote>(len, capacity, batch, false),
+            ingest<Quote>(len, capacity, batch, true),
+        });
+    }
+}
@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+#include "tilt/engine/keyed.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+using namespace std::chrono;
+
+void keyed_bench()
+{
+    size_t len = 1 << 21;
+    size_t nkeys = 256;
+    int64_t w = 10;
+    ts_t step = 1024;
+
+    auto in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    auto op = _MovingSum(in_sym, 1, w);
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("bench_keyed_moving_sum", op), op);
+    auto addr = jit->Lookup(loop->get_name());
+
+    vector<int32_t> data(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = i % 1000;
+    }
+
+    vector<unsigned> threads;
+    auto cores = max(thread::hardware_concurrency(), 1u);
+    for (unsigned n = 1; n < cores; n *= 2) {
+        threads.push_back(n);
+    }
+    threads.push_back(cores);
+
+    // Keys follow a Zipf distribution with exponent `s`, the first key is
+    // the hottest. Rows report the share of the hottest key and the
+    // throughput with each number of threads.
+    vector<string> cols = {"top key (%)"};
+    for (auto n : threads) {
+        cols.push_back(to_string(n) + " thr (Mev/s)");
+    }
+    print_header("keyed (moving_sum)", cols);
+    for (double s : {0.0, 1.0, 1.5}) {
+        vector<double> weights(nkeys);
+        for (size_t k = 0; k < nkeys; k++) {
+            weights[k] = 1 / pow(k + 1, s);
+        }
+        std::mt19937 gen(42);
+        std::discrete_distribution<uint64_t> key_dist(weights.begin(), weights.end());
+        vector<uint64_t> keys(len);
+        for (auto& key : keys) {
+            key = key_dist(gen);
+        }
+
+        vector<double> row = { 100.0 * std::count(keys.begin(), keys.end(), 0) / len };
+        for (auto n : threads) {
+            int64_t checksum = 0;
+            auto sink = [&checksum](uint64_t, const ival_t&, const char* data) {
+                checksum += *reinterpret_cast<const int32_t*>(data);
+            };
+            KeyedExecutor exec(addr, sizeof(int32_t), sizeof(int32_t), sink, step, step, w, 2 * step + w, n);
+
+            auto start = high_resolution_clock::now();
+            for (size_t i = 0; i < len; i++) {
+                exec.Push(keys[i], i, i + 1, reinterpret_cast<char*>(&data[i]));
+                if ((i + 1) % step == 0) {
+                    exec.Run(i + 1);
+                }
+            }
+            auto total = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count() / 1e9;
+            row.push_back(len / total / 1e6);
+        }
+        print_row("zipf s=" + to_string(s).substr(0, 3), row);
+    }
+}
@@ -0,0 +1,103 @@
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+namespace {
+
+struct Tick {
+    int64_t id;
+    float price;
+    int32_t qty;
+    double vol;
+};
+
+// Runs a query over ticks stored in row or column layout
+template<typename OutTy>
+class TickBench : public Benchmark {
+public:
+    TickBench(intptr_t addr, size_t len, bool columnar) :
+        addr(addr), len(len), size(get_buf_size(len)),
+        in_tl(size), in_data(size * sizeof(Tick)), out_tl(size), out_data(size)
+    {
+        init_region(&in_reg, 0, size, in_tl.data(), in_data.data());
+        for (size_t i = 0; i < len; i++) {
+            Tick tick = { static_cast<int64_t>(i), static_cast<float>(i % 100), static_cast<int32_t>(i % 10), 1.0 };
+            commit_data(&in_reg, i + 1);
+            auto idx = get_end_idx(&in_reg);
+            if (columnar) {
+                write_col(idx, offsetof(Tick, id), tick.id);
+                write_col(idx, offsetof(Tick, price), tick.price);
+                write_col(idx, offsetof(Tick, qty), tick.qty);
+                write_col(idx, offsetof(Tick, vol), tick.vol);
+            } else {
+                *reinterpret_cast<Tick*>(fetch(&in_reg, i + 1, idx, sizeof(Tick))) = tick;
+            }
+        }
+    }
+
+private:
+    template<typename T>
+    void write_col(idx_t idx, uint32_t off, T val)
+    {
+        *reinterpret_cast<T*>(fetch_col(&in_reg, idx, off, sizeof(T))) = val;
+    }
+
+    void init() final
+    {
+        init_region(&out_reg, 0, size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+    }
+
+    void execute() final
+    {
+        auto loop = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) addr;
+        loop(0, len, &out_reg, &in_reg);
+    }
+
+    intptr_t addr;
+    size_t len;
+    uint32_t size;
+    region_t in_reg;
+    vector<ival_t> in_tl;
+    vector<char> in_data;
+    region_t out_reg;
+    vector<ival_t> out_tl;
+    vector<OutTy> out_data;
+};
+
+}  // namespace
+
+void layout_bench()
+{
+    int repeat = 10;
+    size_t len = 1 << 22;
+
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int64_t, float, int32_t, double>(), _iter(0, -1)));
+
+    // Reads one and two of the four fields
+    auto price_op = _Map(in_sym, [](Expr e) { return _mul(_get(e, 1), _f32(2)); });
+    auto cost_op = _Map(in_sym, [](Expr e) { return _mul(_get(e, 1), _cast(types::FLOAT32, _get(e, 2))); });
+
+    print_header("layout (ms)", {"price", "cost"});
+    for (auto columnar : {false, true}) {
+        EngineOptions opts;
+        opts.columnar = columnar;
+        auto jit = ExecEngine::Create(opts);
+
+        auto price_loop = jit->AddQuery(_sym("bench_layout_price", price_op), price_op);
+        TickBench<float> price_bench(jit->Lookup(price_loop->get_name()), len, columnar);
+        auto cost_loop = jit->AddQuery(_sym("bench_layout_cost", cost_op), cost_op);
+        TickBench<float> cost_bench(jit->Lookup(cost_loop->get_name()), len, columnar);
+
+        print_row(columnar ? "columns" : "rows", { price_bench.run(repeat) / 1000, cost_bench.run(repeat) / 1000 });
+    }
+}
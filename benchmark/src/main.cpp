@@ -0,0 +1,47 @@
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "bench_base.h"
+
+using namespace std;
+
+int main(int argc, char** argv)
+{
+    map<string, function<void()>> benches = {
+        {"compile", compile_bench},
+        {"deploy", deploy_bench},
+        {"option", option_bench},
+        {"layout", layout_bench},
+        {"timeline", timeline_bench},
+        {"advance", advance_bench},
+        {"ingest", ingest_bench},
+        {"eventlog", eventlog_bench},
+        {"stream", stream_bench},
+        {"concurrent", concurrent_bench},
+        {"parallel", parallel_bench},
+        {"keyed", keyed_bench},
+        {"pipeline", pipeline_bench},
+        {"fusion", fusion_bench},
+        {"sliding", sliding_bench},
+    };
+
+    if (argc < 2) {
+        for (const auto& [_, bench] : benches) {
+            bench();
+        }
+        return 0;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        auto it = benches.find(argv[i]);
+        if (it == benches.end()) {
+            cerr << "Unknown benchmark: " << argv[i] << endl;
+            return 1;
+        }
+        it->second();
+    }
+
+    return 0;
+}
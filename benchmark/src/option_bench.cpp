@@ -0,0 +1,59 @@
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tilt/pass/codegen/loopgen.h"
+#include "tilt/engine/engine.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+static EngineOptions make_options(function<void(EngineOptions&)> set)
+{
+    EngineOptions opts;
+    set(opts);
+    return opts;
+}
+
+void option_bench()
+{
+    int repeat = 10;
+    size_t len = 1 << 20;
+    int64_t dur = 1;
+
+    vector<pair<string, EngineOptions>> options = {
+        {"default", EngineOptions()},
+        {"O0", make_options([](EngineOptions& o) { o.opt_level = 0; })},
+        {"O1", make_options([](EngineOptions& o) { o.opt_level = 1; })},
+        {"O2", make_options([](EngineOptions& o) { o.opt_level = 2; })},
+        {"new-pm", make_options([](EngineOptions& o) { o.new_pm = true; })},
+        {"no-vectorize", make_options([](EngineOptions& o) { o.vectorize = false; })},
+        {"no-unroll", make_options([](EngineOptions& o) { o.unroll = false; })},
+        {"fast-math", make_options([](EngineOptions& o) { o.fast_math = true; })},
+        {"generic-cpu", make_options([](EngineOptions& o) { o.cpu = "generic"; o.features = "+sse,+sse2"; })},
+    };
+
+    auto sel_in_sym = _sym("in", tilt::Type(types::STRUCT<float>(), _iter(0, -1)));
+    auto int_in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+
+    print_header("options (ms)", {"select", "moving_sum"});
+    for (const auto& [name, opts] : options) {
+        auto jit = ExecEngine::Create(opts);
+
+        auto sel_op = _Select(sel_in_sym, [](Expr s) { return _add(s, _f32(1)); });
+        auto sel_loop = LoopGen::Build(_sym("bench_opt_select", sel_op), sel_op.get());
+        jit->AddLoop(sel_loop);
+        QueryBench<float, float> sel_bench(jit->Lookup(sel_loop->get_name()), len, dur);
+
+        auto sum_op = _MovingSum(int_in_sym, 1, 10);
+        auto sum_loop = LoopGen::Build(_sym("bench_opt_moving_sum", sum_op), sum_op.get());
+        jit->AddLoop(sum_loop);
+        QueryBench<int32_t, int32_t> sum_bench(jit->Lookup(sum_loop->get_name()), len, dur);
+
+        print_row(name, { sel_bench.run(repeat) / 1000, sum_bench.run(repeat) / 1000 });
+    }
+}
@@ -0,0 +1,90 @@
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+#include "tilt/engine/parallel.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+namespace {
+
+// Runs a unary float query on a number of threads
+class ParallelBench : public Benchmark {
+public:
+    ParallelBench(Op op, intptr_t addr, unsigned threads, size_t len) :
+        exec(op, addr, sizeof(float), threads), len(len), size(get_buf_size(len)),
+        in_tl(size), in_data(size), out_tl(size), out_data(size)
+    {
+        init_region(&in_reg, 0, size, in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+        for (size_t i = 0; i < len; i++) {
+            commit_data(&in_reg, i + 1);
+            in_data[get_end_idx(&in_reg) & in_reg.mask] = i % 1000;
+        }
+    }
+
+private:
+    void init() final
+    {
+        init_region(&out_reg, 0, size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+    }
+
+    void execute() final { exec.Run(0, len, &out_reg, {&in_reg}); }
+
+    ParallelExecutor exec;
+    size_t len;
+    uint32_t size;
+    region_t in_reg;
+    vector<ival_t> in_tl;
+    vector<float> in_data;
+    region_t out_reg;
+    vector<ival_t> out_tl;
+    vector<float> out_data;
+};
+
+}  // namespace
+
+void parallel_bench()
+{
+    // Multiple of the window of every query
+    size_t len = 4000000;
+    int repeat = 5;
+
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    vector<pair<string, Op>> ops = {
+        {"map", _Map(in_sym, [](Expr e) { return _add(e, _f32(3)); })},
+        {"window_avg(100)", _WindowAvg("bench_parallel_avg", in_sym, 100)},
+        {"norm(1000)", _Norm("bench_parallel_norm", in_sym, 1000)},
+    };
+
+    vector<unsigned> threads;
+    auto cores = max(thread::hardware_concurrency(), 1u);
+    for (unsigned n = 1; n < cores; n *= 2) {
+        threads.push_back(n);
+    }
+    threads.push_back(cores);
+
+    vector<string> cols;
+    for (auto n : threads) {
+        cols.push_back(to_string(n) + " thr (ms)");
+    }
+    print_header("parallel", cols);
+
+    auto jit = ExecEngine::Get();
+    for (size_t i = 0; i < ops.size(); i++) {
+        auto [name, op] = ops[i];
+        auto loop = jit->AddQuery(_sym("bench_parallel_" + to_string(i), op), op);
+        auto addr = jit->Lookup(loop->get_name());
+
+        vector<double> row;
+        for (auto n : threads) {
+            ParallelBench bench(op, addr, n, len);
+            row.push_back(bench.run(repeat) / 1000);
+        }
+        print_row(name, row);
+    }
+}
@@ -0,0 +1,116 @@
+#include <string>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+#include "tilt/engine/pipeline.h"
+#include "tilt/engine/stream.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+namespace {
+
+// Runs a chain of float queries either as a pipeline or one query after
+// another over the whole input, through intermediate regions
+class PipelineBench : public Benchmark {
+public:
+    PipelineBench(vector<PipelineExecutor::Stage> stages, ts_t chunk, bool serial, size_t len) :
+        stages(stages), exec(stages, chunk), serial(serial), len(len), size(get_buf_size(len)),
+        in_tl(size), in_data(size), out_regs(stages.size()), out_tls(stages.size()), out_datas(stages.size())
+    {
+        init_region(&in_reg, 0, size, in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+        for (size_t i = 0; i < len; i++) {
+            commit_data(&in_reg, i + 1);
+            in_data[get_end_idx(&in_reg) & in_reg.mask] = i % 1000;
+        }
+        for (size_t k = 0; k < stages.size(); k++) {
+            out_tls[k].resize(size);
+            out_datas[k].resize(size);
+        }
+    }
+
+    const vector<double>& Utilization() const { return exec.Utilization(); }
+
+private:
+    void init() final
+    {
+        for (size_t k = 0; k < stages.size(); k++) {
+            init_region(&out_regs[k], 0, size, out_tls[k].data(), reinterpret_cast<char*>(out_datas[k].data()));
+        }
+    }
+
+    void execute() final
+    {
+        if (!serial) {
+            exec.Run(0, len, &out_regs.back(), &in_reg);
+            return;
+        }
+
+        auto in = &in_reg;
+        for (size_t k = 0; k < stages.size(); k++) {
+            call_loop(stages[k].addr, 0, len, &out_regs[k], &in, 1);
+            in = &out_regs[k];
+        }
+    }
+
+    vector<PipelineExecutor::Stage> stages;
+    PipelineExecutor exec;
+    bool serial;
+    size_t len;
+    uint32_t size;
+    region_t in_reg;
+    vector<ival_t> in_tl;
+    vector<float> in_data;
+    vector<region_t> out_regs;
+    vector<vector<ival_t>> out_tls;
+    vector<vector<float>> out_datas;
+};
+
+}  // namespace
+
+void pipeline_bench()
+{
+    // Multiple of the chunk
+    size_t len = 4000000;
+    ts_t chunk = 10000;
+    int64_t w = 1000;
+    int repeat = 5;
+
+    // `_Norm` after a map, as a whole and split into its two halves
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto map_op = _Map(in_sym, [](Expr e) { return _add(e, _f32(3)); });
+    auto map_sym = _sym("bench_pipeline_map", map_op);
+    auto norm_op = _Norm("bench_pipeline_norm", map_sym, w);
+    auto split_ops = _NormStages("bench_pipeline_split", map_sym, w);
+    auto sub_op = split_ops[0];
+    auto div_op = split_ops[1];
+
+    auto jit = ExecEngine::Get();
+    auto stage = [&jit](string name, Op op) {
+        auto loop = jit->AddQuery(_sym(name, op), op);
+        return PipelineExecutor::Stage{op, jit->Lookup(loop->get_name()), sizeof(float)};
+    };
+    auto map_stage = stage("bench_pipeline_map", map_op);
+    auto norm_stage = stage("bench_pipeline_norm", norm_op);
+    auto sub_stage = stage("bench_pipeline_sub", sub_op);
+    auto div_stage = stage("bench_pipeline_div", div_op);
+
+    vector<pair<string, vector<PipelineExecutor::Stage>>> pipelines = {
+        {"map|norm", {map_stage, norm_stage}},
+        {"map|norm_sub|norm_div", {map_stage, sub_stage, div_stage}},
+    };
+
+    print_header("pipeline (norm)", {"serial (ms)", "pipeline (ms)", "stage 0 (%)", "stage 1 (%)", "stage 2 (%)"});
+    for (const auto& [name, stages] : pipelines) {
+        PipelineBench serial(stages, chunk, true, len);
+        PipelineBench pipeline(stages, chunk, false, len);
+        vector<double> row = { serial.run(repeat) / 1000, pipeline.run(repeat) / 1000 };
+        for (auto util : pipeline.Utilization()) {
+            row.push_back(100 * util);
+        }
+        print_row(name, row);
+    }
+}
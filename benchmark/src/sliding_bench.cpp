@@ -0,0 +1,45 @@
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+void sliding_bench()
+{
+    int repeat = 3;
+    size_t len = 1000000;
+    int64_t dur = 1;
+    int64_t period = 10;
+
+    vector<pair<string, function<Op(string, _sym, int64_t)>>> queries = {
+        {"avg", [period](string name, _sym in, int64_t w) { return _SlidingAvg(name, in, w, period); }},
+        {"var", [period](string name, _sym in, int64_t w) { return _SlidingVar(name, in, w, period); }},
+    };
+
+    auto jit = ExecEngine::Get();
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+
+    // Recomputing the window costs O(w) per output, updating it O(period)
+    print_header("sliding (ms)", {"recompute", "incremental"});
+    for (const auto& [name, build] : queries) {
+        for (int64_t w : {100, 1000, 10000}) {
+            auto query_name = "bench_sliding_" + name + "_" + to_string(w);
+            auto op = build(query_name, in_sym, w);
+            auto ref_op = _Recompute(build(query_name + "_ref", in_sym, w));
+
+            auto loop = jit->AddQuery(_sym(query_name, op), op);
+            auto ref_loop = jit->AddQuery(_sym(query_name + "_ref", ref_op), ref_op);
+            QueryBench<float, float> bench(jit->Lookup(loop->get_name()), len, dur);
+            QueryBench<float, float> ref_bench(jit->Lookup(ref_loop->get_name()), len, dur);
+
+            print_row(name + " w=" + to_string(w), { ref_bench.run(repeat) / 1000, bench.run(repeat) / 1000 });
+        }
+    }
+}
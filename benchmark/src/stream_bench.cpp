@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+#include "tilt/engine/stream.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+using namespace std::chrono;
+
+void stream_bench()
+{
+    size_t len = 1 << 22;
+    int64_t w = 10;
+
+    auto in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    auto op = _MovingSum(in_sym, 1, w);
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("bench_stream_moving_sum", op), op);
+    auto addr = jit->Lookup(loop->get_name());
+
+    vector<ival_t> in_tl(len);
+    vector<int32_t> in_data(len);
+    for (size_t i = 0; i < len; i++) {
+        in_tl[i] = {static_cast<ts_t>(i), 1};
+        in_data[i] = i % 1000;
+    }
+
+    // Every batch holds one chunk of events, which are processed as soon
+    // as they arrive. Latency is the time from push to the last output.
+    print_header("stream (moving_sum)", {"Mevents/s", "mean lat (us)", "p99 lat (us)"});
+    for (ts_t chunk : {16, 256, 4096, 65536}) {
+        int64_t checksum = 0;
+        auto sink = [&checksum](const ival_t&, const char* data) {
+            checksum += *reinterpret_cast<const int32_t*>(data);
+        };
+        StreamDriver stream(addr, {sizeof(int32_t)}, sizeof(int32_t), sink, chunk, chunk, w, chunk + 1);
+
+        vector<double> lats;
+        auto start = high_resolution_clock::now();
+        for (size_t i = 0; i < len; i += chunk) {
+            auto batch_start = high_resolution_clock::now();
+            auto n = min<size_t>(chunk, len - i);
+            stream.Push(0, &in_tl[i], reinterpret_cast<char*>(&in_data[i]), n);
+            stream.Run();
+            lats.push_back(duration_cast<nanoseconds>(high_resolution_clock::now() - batch_start).count() / 1000.0);
+        }
+        auto total = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count() / 1e9;
+
+        double mean = 0;
+        for (auto lat : lats) {
+            mean += lat / lats.size();
+        }
+        std::sort(lats.begin(), lats.end());
+        auto p99 = lats[lats.size() * 99 / 100];
+
+        print_row("chunk " + to_string(chunk), { len / total / 1e6, mean, p99 });
+    }
+}
@@ -0,0 +1,101 @@
+#include <string>
+#include <vector>
+
+#include "tilt/engine/engine.h"
+
+#include "bench_base.h"
+#include "test_query.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+namespace {
+
+// Runs a unary float query over regions with full or compact timelines
+template<typename IvalTy>
+class TimelineBench : public Benchmark {
+public:
+    TimelineBench(intptr_t addr, size_t len, bool compact) :
+        addr(addr), len(len), size(get_buf_size(len)), compact(compact),
+        in_tl(size), in_data(size), out_tl(size), out_data(size)
+    {
+        init(&in_reg, in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+        for (size_t i = 0; i < len; i++) {
+            auto t = i + 1;
+            compact ? commit_data_compact(&in_reg, t) : commit_data(&in_reg, t);
+            in_data[get_end_idx(&in_reg) & in_reg.mask] = i % 1000;
+        }
+    }
+
+    // Bytes of the input and output timelines
+    size_t tl_bytes() const { return (in_tl.size() + out_tl.size()) * sizeof(IvalTy); }
+
+private:
+    void init(region_t* reg, IvalTy* tl, char* data)
+    {
+        if (compact) {
+            init_region_compact(reg, 0, size, reinterpret_cast<cival_t*>(tl), data);
+        } else {
+            init_region(reg, 0, size, reinterpret_cast<ival_t*>(tl), data);
+        }
+    }
+
+    void init() final { init(&out_reg, out_tl.data(), reinterpret_cast<char*>(out_data.data())); }
+
+    void execute() final
+    {
+        auto loop = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) addr;
+        loop(0, len, &out_reg, &in_reg);
+    }
+
+    intptr_t addr;
+    size_t len;
+    uint32_t size;
+    bool compact;
+    region_t in_reg;
+    vector<IvalTy> in_tl;
+    vector<float> in_data;
+    region_t out_reg;
+    vector<IvalTy> out_tl;
+    vector<float> out_data;
+};
+
+template<typename IvalTy>
+void run_timeline_bench(const string name, bool compact, size_t len, int repeat)
+{
+    EngineOptions opts;
+    opts.compact_tl = compact;
+    auto jit = ExecEngine::Create(opts);
+
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    vector<Op> ops = {
+        _Map(in_sym, [](Expr e) { return _add(e, _f32(3)); }),
+        _WindowAvg("bench_timeline_avg", in_sym, 100),
+        _Norm("bench_timeline_norm", in_sym, 1000),
+    };
+
+    vector<double> row;
+    size_t tl_bytes = 0;
+    for (size_t i = 0; i < ops.size(); i++) {
+        auto loop = jit->AddQuery(_sym("bench_timeline_" + to_string(i), ops[i]), ops[i]);
+        TimelineBench<IvalTy> bench(jit->Lookup(loop->get_name()), len, compact);
+        row.push_back(bench.run(repeat) / 1000);
+        tl_bytes = bench.tl_bytes();
+    }
+    row.push_back(tl_bytes >> 20);
+    print_row(name, row);
+}
+
+}  // namespace
+
+void timeline_bench()
+{
+    int repeat = 10;
+
+    // A multiple of the window sizes of the queries
+    size_t len = 1000000;
+
+    print_header("timeline (ms)", {"map", "window_avg", "norm", "tl MB"});
+    run_timeline_bench<ival_t>("full", false, len, repeat);
+    run_timeline_bench<cival_t>("compact", true, len, repeat);
+}
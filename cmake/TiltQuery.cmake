@@ -0,0 +1,30 @@
+# tilt_add_query(<target> <name> <source>...)
+#
+# Compiles a query ahead of time into the static library <target>. The
+# <source> files define `tilt::Op tilt::aot_query(std::string)`, which
+# builds the query. At build time the query is lowered to a loop named
+# <name>, compiled to an object file and declared in the generated header
+# <name>.h, which is on the include path of <target>. The library only
+# depends on the LLVM-free `tilt_runtime`.
+function(tilt_add_query target name)
+    set(gen ${target}_gen)
+    set(out_dir ${CMAKE_CURRENT_BINARY_DIR}/${target})
+    set(obj ${out_dir}/${name}.o)
+    set(hdr ${out_dir}/${name}.h)
+
+    add_executable(${gen} ${ARGN})
+    target_link_libraries(${gen} tilt_aot_main tilt)
+
+    add_custom_command(
+        OUTPUT ${obj} ${hdr}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${out_dir}
+        COMMAND ${gen} ${name} ${obj} ${hdr}
+        DEPENDS ${gen}
+    )
+    set_source_files_properties(${obj} PROPERTIES EXTERNAL_OBJECT TRUE GENERATED TRUE)
+
+    add_library(${target} STATIC ${obj} ${hdr})
+    set_target_properties(${target} PROPERTIES LINKER_LANGUAGE C)
+    target_include_directories(${target} PUBLIC ${out_dir})
+    target_link_libraries(${target} PUBLIC tilt_runtime)
+endfunction()
@@ -1,29 +1,46 @@
 #ifndef INCLUDE_TILT_BASE_CTYPE_H_
 #define INCLUDE_TILT_BASE_CTYPE_H_
 
+// Shared with C programs that link ahead-of-time compiled queries
+#ifdef __cplusplus
 #include <cstdint>
+#else
+#include <stdint.h>
+#endif
 
 typedef int64_t ts_t;
 typedef int64_t idx_t;
 typedef uint32_t dur_t;
 
+#ifdef __cplusplus
 extern "C" {
+#endif
 
 struct ival_t {
     ts_t t;
     dur_t d;
 };
 
+// Timeline entry of regions with compact timelines, which keeps the low 32
+// bits of the start time. The events of such a region must lie within 2^31
+// time units of its end time.
+struct cival_t {
+    uint32_t t;
+    dur_t d;
+};
+
 struct region_t {
     ts_t st;
     ts_t et;
     idx_t head;
     idx_t count;
     uint32_t mask;
-    ival_t* tl;
+    struct ival_t* tl;
     char* data;
 };
 
+#ifdef __cplusplus
 }  // extern "C"
+#endif
 
 #endif  // INCLUDE_TILT_BASE_CTYPE_H_
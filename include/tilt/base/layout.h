@@ -0,0 +1,34 @@
+#ifndef INCLUDE_TILT_BASE_LAYOUT_H_
+#define INCLUDE_TILT_BASE_LAYOUT_H_
+
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace tilt {
+
+// Memory layout of the regions that generated loops read and write
+struct RegionLayout {
+    // Struct payloads are stored field by field, see `fetch_col`
+    bool columnar = false;
+
+    // Timelines keep 32-bit timestamps, see `cival_t`
+    bool compact = false;
+};
+
+// Throws unless `layout` is the default one, for components of the runtime
+// that only work on regions with row payloads and full timelines
+inline void check_default_layout(RegionLayout layout, const string& user)
+{
+    if (layout.columnar) {
+        throw std::runtime_error(user + " does not support columnar regions");
+    }
+    if (layout.compact) {
+        throw std::runtime_error(user + " does not support compact timelines");
+    }
+}
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_BASE_LAYOUT_H_
@@ -157,23 +157,31 @@ struct Type {
     const DataType dtype;
     const Iter iter;
 
-    Type(DataType dtype, Iter iter) :
-        dtype(std::move(dtype)), iter(iter)
-    {}
+    // Regular streams have a gap-free event every `iter.period` time units
+    // starting at `iter.offset`, so their regions carry no timeline
+    const bool regular;
+
+    Type(DataType dtype, Iter iter, bool regular = false) :
+        dtype(std::move(dtype)), iter(iter), regular(regular)
+    {
+        ASSERT(!regular || iter.period > 0);
+    }
 
     explicit Type(DataType dtype) : Type(std::move(dtype), Iter()) {}
 
     bool is_val() const { return iter.period == 0; }
     bool is_beat() const { return iter.period > 0 && dtype.btype == BaseType::TIME; }
     bool is_out() const { return iter.period == -2; }
+    bool is_regular() const { return regular; }
 
     bool operator==(const Type& o) const
     {
         return (this->dtype == o.dtype)
-            && (this->iter == o.iter);
+            && (this->iter == o.iter)
+            && (this->regular == o.regular);
     }
 
-    string str() const { return iter.str() + " " + dtype.str(); }
+    string str() const { return iter.str() + (regular ? " regular " : " ") + dtype.str(); }
 };
 
 enum class MathOp {
@@ -0,0 +1,49 @@
+#ifndef INCLUDE_TILT_ENGINE_AOT_H_
+#define INCLUDE_TILT_ENGINE_AOT_H_
+
+#include <memory>
+#include <string>
+
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include "tilt/ir/loop.h"
+#include "tilt/ir/op.h"
+#include "tilt/engine/engine.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Compiles loops ahead of time into relocatable object files. The object
+ * contains the optimized loop and the vinstrs it uses, and exports only
+ * the loop function under the given name with the C ABI
+ *
+ *     region_t* <name>(ts_t, ts_t, region_t*, region_t*...);
+ *
+ * so it can be linked into programs without LLVM. Programs prepare their
+ * regions with the vinstrs of the `tilt_runtime` library.
+ */
+class AOTCompiler {
+public:
+    // Targets the host when the triple is empty
+    explicit AOTCompiler(string triple = "", EngineOptions opts = EngineOptions());
+
+    // Arguments are the loop, its exported name and the output path
+    void EmitObject(const Loop, const string&, const string&);
+    void EmitHeader(const Loop, const string&, const string&);
+
+private:
+    static string ctype(const Type&);
+
+    EngineOptions opts;
+    unique_ptr<llvm::TargetMachine> tm;
+};
+
+// Defined by query generators built with the `tilt_add_query` CMake function
+Op aot_query(string);
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_ENGINE_AOT_H_
@@ -0,0 +1,57 @@
+#ifndef INCLUDE_TILT_ENGINE_CACHE_H_
+#define INCLUDE_TILT_ENGINE_CACHE_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Persistent cache of compiled object code. Objects are stored as
+ * `<dir>/<key>.o`, where the key is the identifier of the compiled module.
+ * Only modules whose identifier is a cache key (see `IsKey`) are cached.
+ * When the directory grows beyond `max_size` bytes, the least recently
+ * used objects are evicted.
+ */
+class ObjCache : public llvm::ObjectCache {
+public:
+    static constexpr size_t DEFAULT_MAX_SIZE = 256 << 20;
+
+    ObjCache() : max_size(DEFAULT_MAX_SIZE), hits(0), misses(0) {}
+
+    static string MakeKey(llvm::StringRef hash) { return "tilt-" + hash.str(); }
+    static bool IsKey(llvm::StringRef id) { return id.startswith("tilt-"); }
+
+    void SetDir(string, size_t = DEFAULT_MAX_SIZE);
+    bool Enabled();
+    unique_ptr<llvm::MemoryBuffer> Load(const string&);
+
+    size_t Hits() const { return hits; }
+    size_t Misses() const { return misses; }
+
+    void notifyObjectCompiled(const llvm::Module*, llvm::MemoryBufferRef) override;
+    unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module*) override;
+
+private:
+    unique_ptr<llvm::MemoryBuffer> fetch(const string&);
+    void evict();
+
+    string dir;
+    size_t max_size;
+    atomic<size_t> hits;
+    atomic<size_t> misses;
+    mutex mtx;
+};
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_ENGINE_CACHE_H_
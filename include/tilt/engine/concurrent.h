@@ -0,0 +1,88 @@
+#ifndef INCLUDE_TILT_ENGINE_CONCURRENT_H_
+#define INCLUDE_TILT_ENGINE_CONCURRENT_H_
+
+#include <atomic>
+#include <vector>
+
+#include "tilt/base/ctype.h"
+#include "tilt/base/layout.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Input region shared by a producer thread appending events and a consumer
+ * thread running a loop over them, without locks.
+ *
+ * The producer writes events into the ring buffer and then publishes the
+ * new head and end time with release semantics. The consumer acquires
+ * them, runs the loop over a snapshot of the region up to the published
+ * end time (the watermark), and releases the events it no longer needs.
+ * Loops may look back `lookback` before the time they start at, so events
+ * ending within `lookback` of the released time are kept. The producer
+ * does not overwrite a slot until the consumer has released its event, and
+ * the snapshot only covers events that are not released.
+ *
+ * Gaps before an event are published together with the event, and a
+ * trailing gap with `Advance`. Loops read a trailing gap from the slot the
+ * next event goes to, so the producer waits until the consumer has
+ * released the end time of the gap before it pushes or advances further.
+ * The consumer must therefore run loops only when the watermark is past
+ * the time it released. Only the default region layout is supported.
+ */
+class ConcurrentRegion {
+public:
+    ConcurrentRegion(uint32_t bytes, size_t capacity, dur_t lookback, ts_t start = 0,
+                     RegionLayout layout = RegionLayout());
+
+    ConcurrentRegion(const ConcurrentRegion&) = delete;
+    ConcurrentRegion& operator=(const ConcurrentRegion&) = delete;
+
+    // Producer side. Events are ordered and do not overlap. The `Try`
+    // versions return false without appending when the ring is full, the
+    // others wait for the consumer to release events.
+    bool TryPush(ts_t st, ts_t et, const char* payload);
+    bool TryPush(const ival_t* tl, const char* data, size_t n);
+    void Push(ts_t st, ts_t et, const char* payload);
+    void Push(const ival_t* tl, const char* data, size_t n);
+
+    // Declares the region empty from its end time until `t` and publishes
+    // `t` as the watermark
+    bool TryAdvance(ts_t t);
+    void Advance(ts_t t);
+
+    // Consumer side. Loops run up to the watermark on a snapshot taken
+    // after reading it, and the consumer then releases the time it reached.
+    ts_t Watermark() const { return pub_et.load(memory_order_acquire); }
+    region_t* Snapshot(region_t*) const;
+    void Release(ts_t);
+
+private:
+    bool has_room(size_t) const;
+    void publish();
+
+    uint32_t bytes;
+    dur_t lookback;
+    vector<ival_t> tl;
+    vector<char> data;
+
+    // Owned by the producer. `data_et` is the end time of the last event.
+    region_t reg;
+    ts_t data_et;
+
+    // Written by the producer, read by the consumer
+    atomic<idx_t> pub_head;
+    atomic<ts_t> pub_et;
+
+    // Written by the consumer, read by the producer. Events before `low_idx`
+    // may be overwritten, `low_time` is the earliest time loops may read
+    // and `rel_et` is the time last released.
+    atomic<idx_t> low_idx;
+    atomic<ts_t> rel_et;
+    ts_t low_time;
+};
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_ENGINE_CONCURRENT_H_
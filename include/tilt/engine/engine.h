@@ -1,8 +1,19 @@
 #ifndef INCLUDE_TILT_ENGINE_ENGINE_H_
 #define INCLUDE_TILT_ENGINE_ENGINE_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <utility>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/TargetSelect.h"
@@ -21,45 +32,280 @@
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include "llvm/Transforms/IPO.h"
 
+#include "tilt/ir/loop.h"
+#include "tilt/ir/op.h"
+#include "tilt/pass/codegen/llvmgen.h"
+#include "tilt/engine/cache.h"
+#include "tilt/engine/perf.h"
+
 using namespace std;
 using namespace llvm;
 using namespace llvm::orc;
 
 namespace tilt {
 
+/**
+ * Code generation settings of an engine. Loops are compiled for the host
+ * CPU and its features unless overridden.
+ */
+struct EngineOptions {
+    string cpu;
+    string features;
+
+    // Optimization level from 0 to 3, for both IR passes and codegen
+    unsigned opt_level = 3;
+
+    // Use the new pass manager pipeline instead of the legacy one
+    bool new_pm = false;
+
+    bool vectorize = true;
+    bool unroll = true;
+
+    // Default floating point semantics of queries, can be set per query
+    bool fast_math = false;
+
+    // Store struct payloads of all regions column by column, so that
+    // queries reading few fields touch only their columns. Regions passed
+    // to the loops must use the same layout, see `fetch_col`.
+    bool columnar = false;
+
+    // Keep 32-bit timestamps in the timelines of all regions, which halves
+    // their size. Regions passed to the loops must use the same layout,
+    // see `cival_t`.
+    bool compact_tl = false;
+
+    RegionLayout layout() const { return { columnar, compact_tl }; }
+
+    // Verify generated modules, enabled if the library is a debug build
+    static bool DefaultVerify();
+    bool verify = DefaultVerify();
+
+    // Profiling support: loop symbols in the perf map file, perf jitdump
+    // records (requires LLVM built with LLVM_USE_PERF) and registration of
+    // the loaded objects with GDB
+    bool perf_map = false;
+    bool perf_jitdump = false;
+    bool gdb = false;
+};
+
+/**
+ * Error raised when a query fails to compile. `phase` names the failing
+ * step, e.g. "verify" or "link", and `what()` holds the details.
+ */
+class CompileError : public std::runtime_error {
+public:
+    CompileError(string query, string phase, const string& msg) :
+        std::runtime_error(query + ": " + phase + " failed: " + msg), query(query), phase(phase)
+    {}
+
+    const string query;
+    const string phase;
+};
+
+/**
+ * Time in milliseconds spent by a query in each compilation phase.
+ * Queries loaded from the object cache skip LLVMGen, optimization and
+ * codegen.
+ */
+struct CompileStats {
+    double loopgen = 0;
+    double llvmgen = 0;
+    double optimize = 0;
+    double codegen = 0;
+    double link = 0;
+    bool cached = false;
+    bool linked = false;
+};
+
+/**
+ * IR compiler that reports the codegen time of every module it compiles.
+ */
+class TimedIRCompiler : public IRCompileLayer::IRCompiler {
+public:
+    TimedIRCompiler(unique_ptr<IRCompiler> compiler, function<void(const Module&, double)> report) :
+        IRCompiler(compiler->getManglingOptions()), compiler(std::move(compiler)), report(report)
+    {}
+
+    Expected<unique_ptr<MemoryBuffer>> operator()(Module&) override;
+
+private:
+    unique_ptr<IRCompiler> compiler;
+    function<void(const Module&, double)> report;
+};
+
+enum class Tier {
+    BASELINE,
+    OPTIMIZED,
+};
+
+/**
+ * Handle to a query compiled in tiers. The query starts with a quickly
+ * compiled baseline loop, which is replaced by the optimized loop once the
+ * background compilation finishes. Callers should fetch `Addr()` before
+ * every loop invocation to pick up the optimized code.
+ */
+class TieredQuery {
+public:
+    TieredQuery() : addr(0), tier(Tier::BASELINE), baseline_time(0), optimized_time(0), done(ready.get_future()) {}
+
+    intptr_t Addr() const { return addr.load(memory_order_acquire); }
+    Tier GetTier() const { return tier.load(memory_order_acquire); }
+
+    // Compile times in milliseconds
+    double BaselineTime() const { return baseline_time; }
+    double OptimizedTime() const { return optimized_time; }
+
+    // Blocks until the optimized loop is installed. If the optimized tier
+    // fails to compile, the query keeps the baseline loop and `Wait()`
+    // throws the error. `Addr()` is invalid once the query is removed from
+    // the engine.
+    void Wait() const { done.get(); }
+
+private:
+    atomic<intptr_t> addr;
+    atomic<Tier> tier;
+    atomic<double> baseline_time;
+    atomic<double> optimized_time;
+    promise<void> ready;
+    shared_future<void> done;
+
+    friend class ExecEngine;
+};
+
 class ExecEngine {
 public:
-    ExecEngine(JITTargetMachineBuilder jtmb, DataLayout dl) :
+    ExecEngine(JITTargetMachineBuilder jtmb, DataLayout dl, EngineOptions opts = EngineOptions()) :
         es(createExecutionSession()),
+        opts(opts),
+        jtmb(jtmb),
+        perf_listener(opts.perf_map ? make_unique<PerfMapListener>() : nullptr),
+        target(get_target_id(jtmb, opts)),
         linker(*es, []() { return make_unique<SectionMemoryManager>(); }),
-        compiler(*es, linker, make_unique<ConcurrentIRCompiler>(std::move(jtmb))),
-        optimizer(*es, compiler, optimize_module),
+        baseline_compiler(*es, linker, make_unique<ConcurrentIRCompiler>(get_baseline_jtmb(jtmb))),
+        baseline_optimizer(*es, baseline_compiler, optimize_baseline),
+        compiler(*es, linker, make_unique<TimedIRCompiler>(make_unique<ConcurrentIRCompiler>(std::move(jtmb), &cache),
+            [this](const Module& m, double time) { record(m.getSourceFileName(), &CompileStats::codegen, time); })),
+        optimizer(*es, compiler, [this](ThreadSafeModule tsm, const MaterializationResponsibility& r) {
+            return optimize_module(std::move(tsm), r);
+        }),
         dl(std::move(dl)), mangler(*es, this->dl),
         ctx(make_unique<LLVMContext>()),
-        jd(es->createBareJITDylib("__tilt_dylib"))
+        opt_ctx(make_unique<LLVMContext>()),
+        jd(es->createBareJITDylib("__tilt_dylib")),
+        baseline_jd(es->createBareJITDylib("__tilt_baseline_dylib")),
+        stop_worker(false)
     {
-        jd.addGenerator(cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(dl.getGlobalPrefix())));
+        jd.addGenerator(cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(this->dl.getGlobalPrefix())));
+        baseline_jd.addGenerator(
+            cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(this->dl.getGlobalPrefix())));
+        register_runtime();
+        register_listeners();
     }
 
+    ~ExecEngine();
+
+    // Shared engine with the default options
     static ExecEngine* Get();
+    static unique_ptr<ExecEngine> Create(EngineOptions = EngineOptions());
+    const EngineOptions& GetOptions() const { return opts; }
+
+    // Loops are compiled with the fast-math setting of the engine options,
+    // unless the entry points taking `fast_math` override it for the query
     void AddModule(unique_ptr<Module>);
+    void AddLoop(const Loop);
+    void AddLoop(const Loop, bool fast_math);
+
+    // Lowers the operator with LoopGen and adds the resulting loop. Loops
+    // with bounded output may return before the end time, see `StreamDriver`
+    Loop AddQuery(const Sym, const Op, bool bounded = false);
+    Loop AddQuery(const Sym, const Op, bool bounded, bool fast_math);
+    CompileStats GetStats(const string&);
     LLVMContext& GetCtx();
     intptr_t Lookup(StringRef);
 
+    // Compiles independent loops concurrently on `threads` compile threads
+    // (0 for one per core) and returns the loop addresses in order
+    vector<intptr_t> AddLoops(const vector<Loop>&, unsigned = 0);
+    vector<intptr_t> AddLoops(const vector<Loop>&, unsigned, bool fast_math);
+
+    // Compiles a baseline loop right away and the optimized loop in the background
+    shared_ptr<TieredQuery> AddTieredLoop(const Loop);
+    shared_ptr<TieredQuery> AddTieredLoop(const Loop, bool fast_math);
+
+    // Optimization pipeline applied to every loop before codegen
+    static void OptimizeModule(Module&, TargetMachine&, const EngineOptions&);
+    static void SetFastMath(Module&);
+
+    // Frees the code and data of all loops added under the query name
+    void RemoveQuery(const string&);
+
+    // Object cache keyed by loop structure and host target, disabled by default
+    void SetCacheDir(string, size_t = ObjCache::DEFAULT_MAX_SIZE);
+    string CacheKey(const Loop);
+    string CacheKey(const Loop, bool);
+    ObjCache& GetCache() { return cache; }
+
 private:
-    static Expected<ThreadSafeModule> optimize_module(ThreadSafeModule, const MaterializationResponsibility&);
+    Expected<ThreadSafeModule> optimize_module(ThreadSafeModule, const MaterializationResponsibility&);
+    static Expected<ThreadSafeModule> optimize_baseline(ThreadSafeModule, const MaterializationResponsibility&);
     static unique_ptr<ExecutionSession> createExecutionSession();
+    static string get_target_id(const JITTargetMachineBuilder&, const EngineOptions&);
+    static JITTargetMachineBuilder get_baseline_jtmb(JITTargetMachineBuilder);
+
+    void register_runtime();
+    void register_listeners();
+    intptr_t lookup(JITDylib&, StringRef);
+    void add_module(unique_ptr<Module>, ThreadSafeContext, ResourceTrackerSP);
+    ResourceTrackerSP track(JITDylib&, const string&);
+    void add_loop(const Loop, ThreadSafeContext, bool);
+    ThreadSafeContext get_compile_ctx(size_t);
+    void optimize_tier(const Loop, bool, shared_ptr<TieredQuery>, ResourceTrackerSP);
+    void submit(function<void()>);
+    void record(const string&, double CompileStats::*, double);
+    void run_worker();
 
     unique_ptr<ExecutionSession> es;
+    EngineOptions opts;
+    JITTargetMachineBuilder jtmb;
+    unique_ptr<PerfMapListener> perf_listener;
+    ObjCache cache;
+    string target;
     RTDyldObjectLinkingLayer linker;
+    IRCompileLayer baseline_compiler;
+    IRTransformLayer baseline_optimizer;
     IRCompileLayer compiler;
     IRTransformLayer optimizer;
 
     DataLayout dl;
     MangleAndInterner mangler;
     ThreadSafeContext ctx;
+    ThreadSafeContext opt_ctx;
+
+    // Contexts of the compile threads, kept alive with the engine so that
+    // their parsed vinstr templates are reused across deployments
+    vector<ThreadSafeContext> compile_ctxs;
+    mutex ctx_mtx;
 
     JITDylib& jd;
+    JITDylib& baseline_jd;
+
+    // Resources and compile stats of the loops added by each query, so that
+    // they can be removed together. Pending optimized tiers finish before
+    // removal.
+    struct QueryResources {
+        vector<ResourceTrackerSP> trackers;
+        shared_future<void> pending;
+        CompileStats stats;
+    };
+    map<string, QueryResources> queries;
+    mutex query_mtx;
+
+    // Background compilation of optimized tiers
+    thread worker;
+    deque<function<void()>> jobs;
+    mutex job_mtx;
+    condition_variable job_cv;
+    bool stop_worker;
 };
 
 }  // namespace tilt
@@ -0,0 +1,84 @@
+#ifndef INCLUDE_TILT_ENGINE_EVENTLOG_H_
+#define INCLUDE_TILT_ENGINE_EVENTLOG_H_
+
+#include <cstdio>
+#include <string>
+
+#include "tilt/base/ctype.h"
+#include "tilt/base/layout.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * On-disk event log whose sections have the layout of region buffers, so
+ * that logs can be mapped into memory and scanned by loops without copies.
+ *
+ *     header   EventLogHeader, padded to a page
+ *     timeline count + 1 ival_t, the last one is the end of the log
+ *     data     count payloads of `bytes` bytes, page aligned
+ *
+ * All fields are in host byte order.
+ */
+struct EventLogHeader {
+    static constexpr char MAGIC[8] = { 'T', 'I', 'L', 'T', 'L', 'O', 'G', '\0' };
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t bytes;
+    uint64_t count;
+    ts_t st;
+    ts_t et;
+    uint64_t tl_offset;
+    uint64_t data_offset;
+};
+
+// Writes event logs. Timeline and payloads are written to separate files,
+// which are joined when the log is closed.
+class EventLogWriter {
+public:
+    EventLogWriter(string path, uint32_t bytes, ts_t start = 0);
+    ~EventLogWriter();
+
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter& operator=(const EventLogWriter&) = delete;
+
+    // Events are ordered and do not overlap, gaps between events are empty
+    void Append(ts_t st, ts_t et, const char* payload);
+    void Append(const ival_t* tl, const char* data, size_t n);
+    void Close();
+
+private:
+    string path;
+    string data_path;
+    FILE* tl_file;
+    FILE* data_file;
+    EventLogHeader header;
+};
+
+// Maps an event log read-only and exposes it as an input region. Logs
+// have the default region layout, which loops reading them must use.
+class EventLog {
+public:
+    explicit EventLog(string path, RegionLayout layout = RegionLayout());
+    ~EventLog();
+
+    EventLog(const EventLog&) = delete;
+    EventLog& operator=(const EventLog&) = delete;
+
+    region_t* Region() { return &reg; }
+    uint32_t PayloadSize() const { return header.bytes; }
+    size_t Count() const { return header.count; }
+
+private:
+    EventLogHeader header;
+    char* addr;
+    size_t len;
+    region_t reg;
+};
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_ENGINE_EVENTLOG_H_
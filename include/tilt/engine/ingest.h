@@ -0,0 +1,45 @@
+#ifndef INCLUDE_TILT_ENGINE_INGEST_H_
+#define INCLUDE_TILT_ENGINE_INGEST_H_
+
+#include "tilt/base/ctype.h"
+
+#ifdef __cplusplus
+namespace tilt {
+extern "C" {
+#endif
+
+// Bulk ingestion into input regions. Appends `n` events with intervals
+// `tl` and payloads of `bytes` bytes from `data` after the end of the
+// region, as `n` calls of `commit_data` and writes through `fetch` would.
+// Events must be ordered, must not overlap and must start at or after the
+// end of the region. Gaps between events are empty. If `n` exceeds the
+// capacity of the region, only the last events are kept.
+region_t* commit_batch(region_t* reg, const ival_t* tl, const char* data, uint32_t bytes, uint32_t n);
+
+// Same for columnar regions. `cols` holds one array per field of the
+// struct payload, and `offs` and `sizes` the offsets and sizes of the
+// fields in the struct.
+region_t* commit_col_batch(region_t* reg, const ival_t* tl, const char* const* cols, const uint32_t* offs,
+                           const uint32_t* sizes, uint32_t ncols, uint32_t n);
+
+// Same for regions with compact timelines, see `cival_t`. Batches keep
+// full timestamps, which are truncated as they are copied.
+region_t* commit_batch_compact(region_t* reg, const ival_t* tl, const char* data, uint32_t bytes, uint32_t n);
+region_t* commit_col_batch_compact(region_t* reg, const ival_t* tl, const char* const* cols, const uint32_t* offs,
+                                   const uint32_t* sizes, uint32_t ncols, uint32_t n);
+
+// Regions of regular streams (see `Type::regular`) have no timeline. Event
+// `i` spans (offset + i * period, offset + (i + 1) * period], so the region
+// starting at `t` is empty with its head at the event ending at `t`. `t`
+// must be aligned to the period.
+region_t* init_regular_region(region_t* reg, ts_t offset, dur_t period, ts_t t, uint32_t size, char* data);
+
+// Appends the payloads of the next `n` events of a regular stream
+region_t* commit_regular_batch(region_t* reg, dur_t period, const char* data, uint32_t bytes, uint32_t n);
+
+#ifdef __cplusplus
+}  // extern "C"
+}  // namespace tilt
+#endif
+
+#endif  // INCLUDE_TILT_ENGINE_INGEST_H_
@@ -0,0 +1,127 @@
+#ifndef INCLUDE_TILT_ENGINE_KEYED_H_
+#define INCLUDE_TILT_ENGINE_KEYED_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "tilt/base/ctype.h"
+#include "tilt/base/layout.h"
+#include "tilt/engine/stream.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Thread pool running batches of independent tasks. Tasks are dealt to
+ * the workers in order, and workers that run out of tasks steal from the
+ * others, so that a long task does not hold back the rest of the batch.
+ * Owners take their tasks from the front and thieves from the back, so
+ * batches ordered from the longest task run the long ones first.
+ */
+class WorkStealingPool {
+public:
+    // 0 for one thread per core, the calling thread is one of them
+    explicit WorkStealingPool(unsigned threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Runs the tasks and returns when all of them are done. If tasks throw,
+    // the first exception is rethrown then.
+    void Run(const vector<function<void()>>&);
+
+    unsigned Threads() const { return workers.size(); }
+
+private:
+    typedef const function<void()>* Task;
+
+    struct Worker {
+        mutex mtx;
+        deque<Task> tasks;
+    };
+
+    void work(unsigned);
+    void drain(unsigned);
+    bool take(unsigned, Task&);
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+    atomic<size_t> pending;
+
+    mutex mtx;
+    condition_variable start_cv;
+    condition_variable done_cv;
+    uint64_t epoch;
+    bool stop;
+    exception_ptr error;
+};
+
+/**
+ * Runs a compiled single-input loop once per key of a stream. Events are
+ * routed to a `StreamDriver` per key, which is created when the key is
+ * first seen, starting at the current time. `Run` advances every key to
+ * the same time on a work-stealing pool, starting with the keys that
+ * received the most events, and hands the outputs of all keys to the sink
+ * merged by time. Outputs starting at the same time are ordered by the
+ * key that was seen first.
+ *
+ * Capacities, the lookback, the chunk and the layout are those of the
+ * drivers of every key.
+ */
+class KeyedExecutor {
+public:
+    typedef function<void(uint64_t, const ival_t&, const char*)> Sink;
+
+    KeyedExecutor(intptr_t addr, uint32_t in_size, uint32_t out_size, Sink sink,
+                  ts_t chunk, size_t in_capacity, size_t in_lookback, size_t out_capacity,
+                  unsigned threads = 0, ts_t start = 0, RegionLayout layout = RegionLayout());
+
+    // Appends an event to the input of `key`. Events of a key are ordered,
+    // do not overlap and start at or after the current time.
+    void Push(uint64_t key, ts_t st, ts_t et, const char* payload);
+
+    // Processes every key up to `t`, inputs are empty where they have no
+    // events, and returns the new time
+    ts_t Run(ts_t t);
+
+    ts_t Time() const { return t; }
+    size_t Keys() const { return keys.size(); }
+
+private:
+    struct Key {
+        uint64_t key;
+        unique_ptr<StreamDriver> driver;
+        size_t pushed;
+        vector<ival_t> out_tl;
+        vector<char> out_data;
+    };
+
+    void merge();
+
+    intptr_t addr;
+    uint32_t in_size;
+    uint32_t out_size;
+    Sink sink;
+    ts_t chunk;
+    size_t in_capacity;
+    size_t in_lookback;
+    size_t out_capacity;
+    ts_t t;
+    unordered_map<uint64_t, size_t> index;
+    vector<unique_ptr<Key>> keys;
+    WorkStealingPool pool;
+};
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_ENGINE_KEYED_H_
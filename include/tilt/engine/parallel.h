@@ -0,0 +1,63 @@
+#ifndef INCLUDE_TILT_ENGINE_PARALLEL_H_
+#define INCLUDE_TILT_ENGINE_PARALLEL_H_
+
+#include <vector>
+
+#include "tilt/base/ctype.h"
+#include "tilt/base/layout.h"
+#include "tilt/ir/op.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Runs a compiled loop over a time range on several threads. The range is
+ * split into chunks that are multiples of the operator period, and each
+ * chunk runs on views of the inputs that start early enough for the points
+ * and windows of the operator to look back (see `Lookback`). Inputs are
+ * only read. The outputs of the chunks are appended to the output region
+ * in order, as soon as all chunks before them are done.
+ *
+ * Results are those of a single run of the loop. Where an iteration of the
+ * single run spans a chunk boundary, its outputs are recomputed by a short
+ * serial run until the iterations are in step with the next chunk again.
+ * Operators reading their own output (`out[]`) depend on the previous
+ * chunk and run as a single chunk on the calling thread.
+ * Only the default region layout is supported.
+ */
+class ParallelExecutor {
+public:
+    // `threads` is 0 for one per core and `chunk` 0 for a few chunks per thread
+    ParallelExecutor(const Op op, intptr_t addr, uint32_t out_size, unsigned threads = 0, ts_t chunk = 0,
+                     RegionLayout layout = RegionLayout());
+
+    // Runs the loop over [st, et) and appends the outputs to `out`, whose
+    // capacity must cover them. `ins` are the regions of the inputs that
+    // are not beats, in order. Errors of the chunks are rethrown here once
+    // all threads have stopped.
+    region_t* Run(ts_t st, ts_t et, region_t* out, vector<region_t*> ins);
+
+    // How far back from its start time a loop reads each input that is
+    // not a beat
+    static vector<int64_t> Lookback(const OpNode*);
+
+    // Upper bound on the output events of a loop running for `dur`, at
+    // most one per period
+    static size_t MaxOutputs(const OpNode*, ts_t dur);
+
+    // Whether the operator reads its own previous outputs
+    static bool ReadsOutput(const OpNode*);
+
+private:
+    Op op;
+    intptr_t addr;
+    uint32_t out_size;
+    unsigned threads;
+    ts_t chunk;
+    vector<int64_t> lookback;
+};
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_ENGINE_PARALLEL_H_
@@ -0,0 +1,37 @@
+#ifndef INCLUDE_TILT_ENGINE_PERF_H_
+#define INCLUDE_TILT_ENGINE_PERF_H_
+
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Object/ObjectFile.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Writes the symbols of loaded objects to the perf map file
+ * `/tmp/perf-<pid>.map`, which `perf report` and `perf top` use to name
+ * samples in JIT code. Entries are never removed, as perf maps are
+ * append-only.
+ */
+class PerfMapListener : public llvm::JITEventListener {
+public:
+    PerfMapListener();
+
+    static string Path();
+
+    void notifyObjectLoaded(ObjectKey, const llvm::object::ObjectFile&,
+                            const llvm::RuntimeDyld::LoadedObjectInfo&) override;
+
+private:
+    ofstream out;
+    mutex mtx;
+};
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_ENGINE_PERF_H_
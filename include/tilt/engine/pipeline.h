@@ -0,0 +1,69 @@
+#ifndef INCLUDE_TILT_ENGINE_PIPELINE_H_
+#define INCLUDE_TILT_ENGINE_PIPELINE_H_
+
+#include <vector>
+
+#include "tilt/base/ctype.h"
+#include "tilt/base/layout.h"
+#include "tilt/ir/op.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Runs a chain of compiled loops as a pipeline with one thread per stage.
+ * Every stage reads the output of the stage before it through a
+ * `ConcurrentRegion` and runs over the same time chunks, so that stage k
+ * processes a chunk while stage k-1 is producing the next one. The first
+ * stage reads the input region of `Run` and the last one writes to the
+ * output region.
+ *
+ * Queries are split into stages by turning nested operators into
+ * operators of their own over the output of the previous stage (see
+ * `Split`). `_Norm`, for instance, becomes one stage subtracting the window
+ * average and one dividing by the window standard deviation. Each stage has
+ * a single input that is not a beat, and the chunk must be a multiple of
+ * the period of every stage. As with `StreamDriver`, output events spanning a chunk
+ * boundary are split there, and `out[]` references reach back within the
+ * last two chunks. Only the default region layout is supported.
+ */
+class PipelineExecutor {
+public:
+    struct Stage {
+        Op op;
+        intptr_t addr;
+        uint32_t out_size;
+    };
+
+    // The regions between stages hold `depth` chunks of events, so a stage
+    // can run up to `depth` chunks ahead of the next one
+    PipelineExecutor(vector<Stage> stages, ts_t chunk, size_t depth = 2, RegionLayout layout = RegionLayout());
+
+    // Runs the pipeline over [st, et) and appends the outputs of the last
+    // stage to `out`, whose capacity must cover them
+    region_t* Run(ts_t st, ts_t et, region_t* out, region_t* in);
+
+    // Fraction of the last run each stage spent running its loop and handing
+    // its outputs over, rather than waiting for its input or for room in the
+    // region of the next stage. The busiest stage bounds the throughput.
+    const vector<double>& Utilization() const { return util; }
+
+    // Splits an operator into one stage per symbol of `at`, each a nested
+    // operator of `op`, and a last stage computing the output. A stage
+    // computes its nested operator from the symbols it depends on, and
+    // later stages read its output through a window covering one period,
+    // bound to the same symbol. Stages only read the stage before them.
+    static vector<Op> Split(const Op op, const vector<Sym>& at);
+
+private:
+    vector<Stage> stages;
+    ts_t chunk;
+    size_t depth;
+    vector<int64_t> lookback;
+    vector<double> util;
+};
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_ENGINE_PIPELINE_H_
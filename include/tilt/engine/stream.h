@@ -0,0 +1,103 @@
+#ifndef INCLUDE_TILT_ENGINE_STREAM_H_
+#define INCLUDE_TILT_ENGINE_STREAM_H_
+
+#include <functional>
+#include <vector>
+
+#include "tilt/base/ctype.h"
+#include "tilt/base/layout.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Runs a compiled loop incrementally over a stream. The driver owns ring
+ * buffers for the inputs and the output, accepts batches of input events
+ * and invokes the loop over successive time chunks of `chunk` as soon as
+ * all inputs have reached the end of a chunk. Regions persist across
+ * invocations, so windows looking back into the inputs and references to
+ * previous outputs (`out[]`) see the events of earlier chunks.
+ *
+ * The input capacity bounds the events pushed ahead of the stream time and
+ * must cover the events of one chunk. The input rings also keep
+ * `in_lookback` events behind it, which must cover the longest lookback
+ * window. The output capacity must cover the outputs of one chunk plus the
+ * longest `out[]` reference. The chunk should be a multiple of the
+ * loop period. Completed output events are handed to the sink in order.
+ * Works with loops from the JIT and with ahead-of-time compiled ones, which
+ * must use the default region layout.
+ *
+ * Loops built with bounded output (see `LoopGen::Build`) return when they
+ * reach the high-water mark of the output ring, and the driver drains the
+ * ring before resuming them. The output capacity then only has to cover
+ * the outputs of one loop iteration plus the longest `out[]` reference,
+ * and memory stays bounded however many outputs a chunk has.
+ *
+ * Batch sinks may consume fewer events than they are given. The driver
+ * then pauses: it keeps the rest in the ring and does not run the loop
+ * again until a later `Run` or `Flush` has drained them.
+ */
+class StreamDriver {
+public:
+    typedef function<void(const ival_t&, const char*)> Sink;
+
+    // Receives `n` consecutive output events, whose payloads are `out_size`
+    // bytes apart, and returns how many of them it consumed
+    typedef function<size_t(const ival_t*, const char*, size_t)> BatchSink;
+
+    StreamDriver(intptr_t addr, vector<uint32_t> in_sizes, uint32_t out_size, Sink sink,
+                 ts_t chunk, size_t in_capacity, size_t in_lookback, size_t out_capacity, ts_t start = 0,
+                 RegionLayout layout = RegionLayout());
+    StreamDriver(intptr_t addr, vector<uint32_t> in_sizes, uint32_t out_size, BatchSink sink,
+                 ts_t chunk, size_t in_capacity, size_t in_lookback, size_t out_capacity, ts_t start = 0,
+                 RegionLayout layout = RegionLayout());
+
+    // Appends events to input `i`. Events are ordered and do not overlap,
+    // gaps between events are empty. Batches are copied in bulk and are
+    // rejected as a whole if they do not fit.
+    void Push(size_t i, ts_t st, ts_t et, const char* payload);
+    void Push(size_t i, const ival_t* tl, const char* data, size_t n);
+
+    // Processes all chunks completed by every input and returns the new
+    // stream time, which is behind them if the sink paused the stream
+    ts_t Run();
+
+    // Declares inputs empty until `t` and processes the stream up to `t`
+    ts_t Flush(ts_t t);
+
+    ts_t Time() const { return t; }
+
+    // Output events not consumed by the sink yet
+    size_t Pending() const { return out.reg.head - out.run_head; }
+
+private:
+    struct Buffer {
+        region_t reg;
+        uint32_t size;
+        vector<ival_t> tl;
+        vector<char> data;
+        idx_t run_head;
+    };
+
+    void init_buffer(Buffer&, uint32_t, size_t);
+    void run_until(ts_t);
+    void invoke(ts_t, ts_t);
+    bool drain();
+
+    intptr_t addr;
+    BatchSink sink;
+    ts_t chunk;
+    size_t in_capacity;
+    ts_t start;
+    ts_t t;
+    vector<Buffer> ins;
+    Buffer out;
+};
+
+// Calls the loop at `addr` over [st, et) with `n` input regions, from 1 to 4
+region_t* call_loop(intptr_t addr, ts_t st, ts_t et, region_t* out, region_t* const* ins, size_t n);
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_ENGINE_STREAM_H_
@@ -38,18 +38,33 @@ struct Reduce : public ValNode {
     Val state;
     AccTy acc;
 
-    Reduce(Sym lstream, Val state, AccTy acc) :
-        ValNode(state->type.dtype), lstream(lstream), state(state), acc(acc)
+    // Inverse of the accumulate function, which removes an event from the
+    // state. Reductions over a window of the enclosing operator that have
+    // one are updated with the events entering and leaving the window,
+    // rather than recomputed over the whole window.
+    AccTy evict;
+
+    // Values of the enclosing operator read by the accumulate function
+    Params args;
+
+    Reduce(Sym lstream, Val state, AccTy acc, AccTy evict = nullptr, Params args = {}) :
+        ValNode(state->type.dtype), lstream(lstream), state(state), acc(acc), evict(evict), args(std::move(args))
     {
         auto st = make_shared<Symbol>("st", Type(types::TIME));
         auto et = make_shared<Symbol>("et", Type(types::TIME));
         auto data = make_shared<Symbol>("data", Type(lstream->type.dtype));
         ASSERT(acc(state, st, et, data)->type == Type(state->type.dtype));
+        ASSERT(!evict || evict(state, st, et, data)->type == Type(state->type.dtype));
     }
 
     void Accept(Visitor&) const final;
 };
 
+// Calls `fn` on an expression and on the expressions it reads, without
+// expanding symbols. Nested operators read their inputs, and reductions
+// their stream, state, arguments and functions.
+void walk(const Expr&, const function<void(const Expr&)>&);
+
 }  // namespace tilt
 
 
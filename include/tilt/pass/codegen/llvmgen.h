@@ -5,9 +5,12 @@
 #include <utility>
 #include <string>
 #include <vector>
+#include <map>
+#include <mutex>
 #include <cstdlib>
 #include <fstream>
 
+#include "tilt/base/layout.h"
 #include "tilt/pass/irgen.h"
 
 #include "llvm/IR/LLVMContext.h"
@@ -18,10 +21,12 @@
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 using namespace std;
 
-extern const char* vinstr_str;
+extern const unsigned char vinstr_bc[];
+extern const size_t vinstr_bc_len;
 
 namespace tilt {
 
@@ -36,20 +41,28 @@ private:
     const LoopNode* loop;
     llvm::LLVMContext* llctx;
     unique_ptr<map<Sym, llvm::Value*>> map_backup;
+    bool uses_pool = false;
     friend class LLVMGen;
 };
 
 class LLVMGen : public IRGen<LLVMGenCtx, Expr, llvm::Value*> {
 public:
-    explicit LLVMGen(LLVMGenCtx llgenctx) :
-        _ctx(std::move(llgenctx)), _llctx(*ctx().llctx),
-        _llmod(make_unique<llvm::Module>(ctx().loop->name, _llctx)),
-        _builder(make_unique<llvm::IRBuilder<>>(_llctx))
+    explicit LLVMGen(LLVMGenCtx llgenctx, RegionLayout layout = RegionLayout()) :
+        _ctx(std::move(llgenctx)), layout(layout), _llctx(*ctx().llctx),
+        _llmod(make_unique<llvm::Module>(ctx().loop->get_name(), _llctx)),
+        _builder(make_unique<llvm::IRBuilder<>>(_llctx)),
+        _vinstr_mod(vinstr_module(_llctx))
     {
-        register_vinstrs();
+        // Sizes of generated types must agree with the layout of the linked
+        // vinstrs, which were compiled for the host
+        _llmod->setDataLayout(_vinstr_mod.getDataLayout());
+        _llmod->setTargetTriple(_vinstr_mod.getTargetTriple());
     }
 
-    static unique_ptr<llvm::Module> Build(const Loop, llvm::LLVMContext&);
+    static unique_ptr<llvm::Module> Build(const Loop, llvm::LLVMContext&, RegionLayout = RegionLayout());
+
+    // Regions of static size up to this many bytes are allocated on the stack
+    static constexpr uint64_t MAX_STACK_REGION_SIZE = 16 << 10;
 
 private:
     LLVMGenCtx& ctx() override { return _ctx; }
@@ -91,6 +104,11 @@ private:
         val->setName(sym_ptr->name);
     }
 
+    const Fetch* col_fetch(const Expr&);
+    const Read* col_read(const Expr&);
+    llvm::Value* llcolptr(const Fetch&, size_t);
+
+    static const llvm::Module& vinstr_module(llvm::LLVMContext&);
     void register_vinstrs();
 
     llvm::Function* llfunc(const string, llvm::Type*, vector<llvm::Type*>);
@@ -99,6 +117,10 @@ private:
 
     llvm::Value* llsizeof(llvm::Type*);
 
+    // Vinstrs that access the timeline have a variant for each layout
+    string tlvinstr(const string name) { return layout.compact ? name + "_compact" : name; }
+    llvm::Type* lltltype();
+
     llvm::Type* lltype(const DataType&);
     llvm::Type* lltype(const Type&);
     llvm::Type* lltype(const ExprNode& expr) { return lltype(expr.type); }
@@ -112,9 +134,11 @@ private:
     llvm::IRBuilder<>* builder() { return _builder.get(); }
 
     LLVMGenCtx _ctx;
+    RegionLayout layout;
     llvm::LLVMContext& _llctx;
     unique_ptr<llvm::Module> _llmod;
     unique_ptr<llvm::IRBuilder<>> _builder;
+    const llvm::Module& _vinstr_mod;
 };
 
 }  // namespace tilt
@@ -29,9 +29,11 @@ private:
 
 class LoopGen : public IRGen<LoopGenCtx, Expr, Expr> {
 public:
-    explicit LoopGen(LoopGenCtx ctx) : _ctx(std::move(ctx)) {}
+    explicit LoopGen(LoopGenCtx ctx, bool bounded = false) : _ctx(std::move(ctx)), bounded(bounded) {}
 
-    static Loop Build(Sym, const OpNode*);
+    // Loops with bounded output return early once they have filled half of
+    // the output ring, see `StreamDriver`
+    static Loop Build(Sym, const OpNode*, bool bounded = false);
 
 private:
     LoopGenCtx& ctx() override { return _ctx; }
@@ -42,6 +44,8 @@ private:
     void set_ref(Sym sym, Sym ref) { ctx().sym_ref[sym] = ref; }
     void build_tloop(function<Expr()>, function<Expr()>);
     void build_loop();
+    Loop build_red_loop(const Reduce&, Sym, AccTy);
+    Expr build_incr_red(const Reduce&, const SubLStream&);
 
     Expr visit(const Symbol&) final;
     Expr visit(const Out&) final;
@@ -75,6 +79,7 @@ private:
     Expr visit(const LoopNode&) final { throw runtime_error("Invalid expression"); };
 
     LoopGenCtx _ctx;
+    bool bounded;
 };
 
 }  // namespace tilt
@@ -0,0 +1,42 @@
+#ifndef INCLUDE_TILT_PASS_CODEGEN_POOL_H_
+#define INCLUDE_TILT_PASS_CODEGEN_POOL_H_
+
+#include "tilt/base/ctype.h"
+
+#ifdef __cplusplus
+namespace tilt {
+extern "C" {
+#endif
+
+// Allocation counters of the region pool, summed over all threads
+typedef struct pool_stats_t {
+    // Buffers allocated from and freed to the system
+    uint64_t allocs;
+    uint64_t frees;
+    // Buffers borrowed from and returned to the pool
+    uint64_t borrows;
+    uint64_t returns;
+    // Bytes currently held by the pool, borrowed or not
+    uint64_t bytes;
+} pool_stats_t;
+
+// Pool of buffers for intermediate regions, with free lists per thread
+// keyed by event size and capacity. A buffer holds the timeline of `size`
+// events followed by their data, `ev_bytes` bytes per event in total.
+//
+// Loops take a mark on entry and at the start of every iteration, and
+// release every buffer borrowed after the mark on exit and at the end of
+// the iteration. Unlike vinstrs these are not inlined into the generated
+// code, because the pool is shared by all loops of a thread.
+char* pool_borrow(uint32_t size, uint32_t ev_bytes);
+uint64_t pool_mark();
+void pool_release(uint64_t mark);
+
+void pool_stats(pool_stats_t*);
+
+#ifdef __cplusplus
+}  // extern "C"
+}  // namespace tilt
+#endif
+
+#endif  // INCLUDE_TILT_PASS_CODEGEN_POOL_H_
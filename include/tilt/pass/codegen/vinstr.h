@@ -11,16 +11,27 @@ extern "C" {
 TILT_VINSTR_ATTR uint32_t get_buf_size(idx_t);
 TILT_VINSTR_ATTR idx_t get_start_idx(region_t*);
 TILT_VINSTR_ATTR idx_t get_end_idx(region_t*);
+TILT_VINSTR_ATTR idx_t get_high_water(region_t*);
 TILT_VINSTR_ATTR ts_t get_start_time(region_t*);
 TILT_VINSTR_ATTR ts_t get_end_time(region_t*);
 TILT_VINSTR_ATTR ts_t get_ckpt(region_t*, ts_t, idx_t);
 TILT_VINSTR_ATTR idx_t advance(region_t*, idx_t, ts_t);
 TILT_VINSTR_ATTR char* fetch(region_t*, ts_t, idx_t, uint32_t);
+TILT_VINSTR_ATTR char* fetch_col(region_t*, idx_t, uint32_t, uint32_t);
+TILT_VINSTR_ATTR char* fetch_regular(region_t*, ts_t, idx_t, uint32_t);
 TILT_VINSTR_ATTR region_t* make_region(region_t*, region_t*, ts_t, idx_t, ts_t, idx_t);
 TILT_VINSTR_ATTR region_t* init_region(region_t*, ts_t, uint32_t, ival_t*, char*);
 TILT_VINSTR_ATTR region_t* commit_data(region_t*, ts_t);
 TILT_VINSTR_ATTR region_t* commit_null(region_t*, ts_t);
 
+// Same for regions with compact timelines, see `cival_t`
+TILT_VINSTR_ATTR ts_t get_ckpt_compact(region_t*, ts_t, idx_t);
+TILT_VINSTR_ATTR idx_t advance_compact(region_t*, idx_t, ts_t);
+TILT_VINSTR_ATTR char* fetch_compact(region_t*, ts_t, idx_t, uint32_t);
+TILT_VINSTR_ATTR region_t* init_region_compact(region_t*, ts_t, uint32_t, cival_t*, char*);
+TILT_VINSTR_ATTR region_t* commit_data_compact(region_t*, ts_t);
+TILT_VINSTR_ATTR region_t* commit_null_compact(region_t*, ts_t);
+
 }  // extern "C"
 }  // namespace tilt
 
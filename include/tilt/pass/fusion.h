@@ -0,0 +1,39 @@
+#ifndef INCLUDE_TILT_PASS_FUSION_H_
+#define INCLUDE_TILT_PASS_FUSION_H_
+
+#include "tilt/ir/op.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Rewrites an operator so that nested operators whose outputs are only
+ * read point by point are not materialized. Within every operator:
+ *
+ *  1. An operator reading the output of a point-wise sibling operator at
+ *     `[0]`, with the same iterator, computes the sibling's output itself
+ *     from the sibling's inputs (e.g. Select -> Select).
+ *  2. A reduction over the output of a point-wise sibling operator with
+ *     iterator (0, 1), whose input is a window covering one period of the
+ *     enclosing operator, reduces that window directly and applies the
+ *     sibling's expression to every event (e.g. Select -> Reduce).
+ *  3. Reductions over the same stream with constant scalar initial states
+ *     and no other arguments are merged into one reduction over a struct
+ *     state, so that the stream is scanned once (e.g. count and sum).
+ *     Reductions with an evict function are only merged with each other.
+ *
+ * Operators are point-wise when they read their inputs at `[0]` only and
+ * have no nested operators or reductions. Symbols that are no longer
+ * referenced are dropped. The input operator is left untouched, and the
+ * names of the rewritten symbols are kept, so fused and unfused versions
+ * of a query must use different names to live in the same engine.
+ */
+class OpFusion {
+public:
+    static Op Build(const Op);
+};
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_PASS_FUSION_H_
@@ -0,0 +1,66 @@
+#ifndef INCLUDE_TILT_PASS_HASHER_H_
+#define INCLUDE_TILT_PASS_HASHER_H_
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tilt/pass/visitor.h"
+
+using namespace std;
+
+namespace tilt {
+
+/**
+ * Serializes an IR tree into a canonical form that does not depend on
+ * symbol addresses, and hashes it. Two structurally identical loops
+ * produce the same hash across processes.
+ */
+class IRHasher : public Visitor {
+public:
+    static string Build(const Expr);
+    static string Hash(const string&);
+
+    void Visit(const Symbol&) override;
+    void Visit(const Out&) override;
+    void Visit(const Beat&) override;
+    void Visit(const Call&) override;
+    void Visit(const IfElse&) override;
+    void Visit(const Select&) override;
+    void Visit(const Get&) override;
+    void Visit(const New&) override;
+    void Visit(const Exists&) override;
+    void Visit(const ConstNode&) override;
+    void Visit(const Cast&) override;
+    void Visit(const NaryExpr&) override;
+    void Visit(const SubLStream&) override;
+    void Visit(const Element&) override;
+    void Visit(const OpNode&) override;
+    void Visit(const Reduce&) override;
+    void Visit(const Fetch&) override;
+    void Visit(const Read&) override;
+    void Visit(const Write&) override;
+    void Visit(const Advance&) override;
+    void Visit(const GetCkpt&) override;
+    void Visit(const GetStartIdx&) override;
+    void Visit(const GetEndIdx&) override;
+    void Visit(const GetStartTime&) override;
+    void Visit(const GetEndTime&) override;
+    void Visit(const CommitData&) override;
+    void Visit(const CommitNull&) override;
+    void Visit(const AllocRegion&) override;
+    void Visit(const MakeRegion&) override;
+    void Visit(const LoopNode&) override;
+
+private:
+    static string serialize(const Expr);
+
+    void emitnode(const string, const vector<Expr>);
+    void emitdefs(const SymTable&);
+
+    ostringstream ostr;
+};
+
+}  // namespace tilt
+
+#endif  // INCLUDE_TILT_PASS_HASHER_H_
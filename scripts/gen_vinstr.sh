@@ -2,13 +2,19 @@ CMAKE_CXX_COMPILER=$1
 CMAKE_CURRENT_SOURCE_DIR=$2
 CMAKE_CURRENT_BINARY_DIR=$3
 
-${CMAKE_CXX_COMPILER} -emit-llvm -S ${CMAKE_CURRENT_SOURCE_DIR}/pass/codegen/vinstr.cpp \
+${CMAKE_CXX_COMPILER} -emit-llvm -c ${CMAKE_CURRENT_SOURCE_DIR}/pass/codegen/vinstr.cpp \
                    -I ${CMAKE_CURRENT_SOURCE_DIR}/../include/ \
-                   -o ${CMAKE_CURRENT_BINARY_DIR}/vinstr.ll
+                   -o ${CMAKE_CURRENT_BINARY_DIR}/vinstr.bc
 
-VINSTR_IR=$(cat ${CMAKE_CURRENT_BINARY_DIR}/vinstr.ll)
+VINSTR_BC=$(od -An -v -tx1 ${CMAKE_CURRENT_BINARY_DIR}/vinstr.bc | sed -E 's/ ([0-9a-f]{2})/0x\1, /g')
 
-echo "const char* vinstr_str = R\"(
-${VINSTR_IR}
-)\";
-" > ${CMAKE_CURRENT_BINARY_DIR}/vinstr_str.cpp
+echo "#include <cstddef>
+
+extern const unsigned char vinstr_bc[];
+extern const size_t vinstr_bc_len;
+
+alignas(8) const unsigned char vinstr_bc[] = {
+${VINSTR_BC}
+};
+const size_t vinstr_bc_len = sizeof(vinstr_bc);
+" > ${CMAKE_CURRENT_BINARY_DIR}/vinstr_bc.cpp
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "tilt/engine/aot.h"
+#include "tilt/pass/codegen/llvmgen.h"
+
+using namespace tilt;
+
+AOTCompiler::AOTCompiler(string triple, EngineOptions opts) : opts(opts)
+{
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+
+    auto jtmb = triple.empty() ? cantFail(JITTargetMachineBuilder::detectHost())
+        : JITTargetMachineBuilder(Triple(triple));
+    if (!opts.cpu.empty()) {
+        jtmb.setCPU(opts.cpu);
+    }
+    if (!opts.features.empty()) {
+        jtmb.getFeatures() = SubtargetFeatures(opts.features);
+    }
+
+    // Objects are linked into arbitrary executables and shared libraries
+    jtmb.setRelocationModel(Reloc::PIC_);
+    tm = cantFail(jtmb.createTargetMachine());
+}
+
+void AOTCompiler::EmitObject(const Loop loop, const string& name, const string& path)
+{
+    // Vinstr templates are kept per context, so all AOT compilation shares
+    // one long-lived context
+    static LLVMContext llctx;
+    static mutex llctx_mtx;
+    lock_guard<mutex> lock(llctx_mtx);
+
+    auto m = LLVMGen::Build(loop, llctx, opts.layout());
+    m->setTargetTriple(tm->getTargetTriple().str());
+    m->setDataLayout(tm->createDataLayout());
+
+    // Only the loop function is exported, everything else can be inlined
+    auto loop_fn = m->getFunction(loop->get_name());
+    for (auto& fn : m->functions()) {
+        if (!fn.isDeclaration() && &fn != loop_fn) {
+            fn.setLinkage(Function::InternalLinkage);
+        }
+    }
+    loop_fn->setName(name);
+    if (loop_fn->getName() != name) {
+        throw std::runtime_error("Export name " + name + " is already used by the query");
+    }
+    if (verifyModule(*m, &errs())) {
+        throw std::runtime_error("Invalid module for loop " + loop->get_name());
+    }
+    if (opts.fast_math) {
+        ExecEngine::SetFastMath(*m);
+    }
+    ExecEngine::OptimizeModule(*m, *tm, opts);
+
+    std::error_code ec;
+    raw_fd_ostream out(path, ec, sys::fs::OF_None);
+    if (ec) {
+        throw std::runtime_error("Failed to open " + path + ": " + ec.message());
+    }
+
+    legacy::PassManager pm;
+    if (tm->addPassesToEmitFile(pm, out, nullptr, CGFT_ObjectFile)) {
+        throw std::runtime_error("Target cannot emit object files");
+    }
+    pm.run(*m);
+}
+
+void AOTCompiler::EmitHeader(const Loop loop, const string& name, const string& path)
+{
+    auto guard = "TILT_QUERY_" + name + "_H_";
+    transform(guard.begin(), guard.end(), guard.begin(), ::toupper);
+
+    string args;
+    for (const auto& input : loop->inputs) {
+        args += (args.empty() ? "" : ", ") + ctype(input->type);
+    }
+
+    ofstream out(path);
+    out << "// Generated by tilt from loop " << loop->get_name() << ". Do not edit." << endl
+        << "#ifndef " << guard << endl
+        << "#define " << guard << endl
+        << endl
+        << "#include \"tilt/base/ctype.h\"" << endl
+        << endl
+        << "#ifdef __cplusplus" << endl
+        << "extern \"C\" {" << endl
+        << "#endif" << endl
+        << endl
+        << ctype(loop->output->type) << " " << name << "(" << args << ");" << endl
+        << endl
+        << "#ifdef __cplusplus" << endl
+        << "}  // extern \"C\"" << endl
+        << "#endif" << endl
+        << endl
+        << "#endif  // " << guard << endl;
+    if (!out) {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+string AOTCompiler::ctype(const Type& type)
+{
+    if (!type.is_val()) {
+        return "struct region_t*";
+    }
+
+    switch (type.dtype.btype) {
+        case BaseType::INT8: return "int8_t";
+        case BaseType::INT16: return "int16_t";
+        case BaseType::INT32: return "int32_t";
+        case BaseType::INT64: return "int64_t";
+        case BaseType::UINT8: return "uint8_t";
+        case BaseType::UINT16: return "uint16_t";
+        case BaseType::UINT32: return "uint32_t";
+        case BaseType::UINT64: return "uint64_t";
+        case BaseType::FLOAT32: return "float";
+        case BaseType::FLOAT64: return "double";
+        case BaseType::TIME: return "ts_t";
+        case BaseType::INDEX: return "idx_t";
+        default: throw std::runtime_error("Type has no C ABI: " + type.str());
+    }
+}
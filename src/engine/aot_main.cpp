@@ -0,0 +1,33 @@
+#include <iostream>
+#include <string>
+
+#include "tilt/builder/tilder.h"
+#include "tilt/engine/aot.h"
+#include "tilt/pass/codegen/loopgen.h"
+
+using namespace std;
+using namespace tilt;
+using namespace tilt::tilder;
+
+// Query generator driver for the `tilt_add_query` CMake function
+//
+//     <generator> <name> <object> <header> [<triple> [<cpu>]]
+int main(int argc, char** argv)
+{
+    if (argc < 4 || argc > 6) {
+        cerr << "Usage: " << argv[0] << " <name> <object> <header> [<triple> [<cpu>]]" << endl;
+        return 1;
+    }
+
+    string name = argv[1];
+    auto op = aot_query(name);
+    auto loop = LoopGen::Build(_sym(name, op), op.get());
+
+    EngineOptions opts;
+    opts.cpu = (argc > 5) ? argv[5] : "";
+    AOTCompiler compiler((argc > 4) ? argv[4] : "", opts);
+    compiler.EmitObject(loop, name, argv[2]);
+    compiler.EmitHeader(loop, name, argv[3]);
+
+    return 0;
+}
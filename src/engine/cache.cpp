@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+#include <vector>
+
+#include "tilt/engine/cache.h"
+
+using namespace tilt;
+namespace fs = std::filesystem;
+
+void ObjCache::SetDir(string dir, size_t max_size)
+{
+    lock_guard<mutex> lock(mtx);
+    this->dir = dir;
+    this->max_size = max_size;
+    if (!dir.empty()) {
+        fs::create_directories(dir);
+    }
+}
+
+bool ObjCache::Enabled()
+{
+    lock_guard<mutex> lock(mtx);
+    return !dir.empty();
+}
+
+unique_ptr<llvm::MemoryBuffer> ObjCache::fetch(const string& key)
+{
+    lock_guard<mutex> lock(mtx);
+    if (dir.empty()) { return nullptr; }
+
+    auto path = fs::path(dir) / (key + ".o");
+    std::error_code ec;
+    if (!fs::exists(path, ec)) { return nullptr; }
+
+    auto buf = llvm::MemoryBuffer::getFile(path.string(), false, false);
+    if (!buf) { return nullptr; }
+
+    // Refresh the modification time so that eviction is least recently used
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return std::move(*buf);
+}
+
+unique_ptr<llvm::MemoryBuffer> ObjCache::Load(const string& key)
+{
+    auto obj = fetch(key);
+    if (obj) {
+        hits++;
+    } else {
+        misses++;
+    }
+    return obj;
+}
+
+unique_ptr<llvm::MemoryBuffer> ObjCache::getObject(const llvm::Module* m)
+{
+    // Hits and misses are counted by `Load`, which runs before IR generation.
+    // Here we only serve modules that were added with a cache key directly.
+    auto id = m->getModuleIdentifier();
+    return IsKey(id) ? fetch(id) : nullptr;
+}
+
+void ObjCache::notifyObjectCompiled(const llvm::Module* m, llvm::MemoryBufferRef obj)
+{
+    auto id = m->getModuleIdentifier();
+    if (!IsKey(id)) { return; }
+
+    lock_guard<mutex> lock(mtx);
+    if (dir.empty()) { return; }
+
+    // Write to a temporary file first so that concurrent readers never
+    // observe a partially written object.
+    auto path = fs::path(dir) / (id + ".o");
+    auto tmp_path = fs::path(dir) / (id + ".o.tmp");
+    {
+        ofstream out(tmp_path, ios::binary | ios::trunc);
+        out.write(obj.getBufferStart(), obj.getBufferSize());
+        if (!out) { return; }
+    }
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+
+    evict();
+}
+
+void ObjCache::evict()
+{
+    vector<tuple<fs::file_time_type, uintmax_t, fs::path>> objs;
+    uintmax_t total = 0;
+
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.path().extension() != ".o") { continue; }
+        auto size = entry.file_size(ec);
+        objs.emplace_back(entry.last_write_time(ec), size, entry.path());
+        total += size;
+    }
+
+    sort(objs.begin(), objs.end());
+    for (const auto& [_, size, path] : objs) {
+        if (total <= max_size) { break; }
+        if (fs::remove(path, ec)) {
+            total -= size;
+        }
+    }
+}
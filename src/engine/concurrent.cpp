@@ -0,0 +1,145 @@
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#include "tilt/engine/concurrent.h"
+#include "tilt/engine/ingest.h"
+#include "tilt/pass/codegen/vinstr.h"
+
+using namespace tilt;
+
+ConcurrentRegion::ConcurrentRegion(uint32_t bytes, size_t capacity, dur_t lookback, ts_t start,
+                                   RegionLayout layout) :
+    bytes(bytes), lookback(lookback), tl(get_buf_size(capacity)),
+    data(static_cast<size_t>(get_buf_size(capacity)) * bytes), data_et(start), low_time(start)
+{
+    check_default_layout(layout, "ConcurrentRegion");
+    init_region(&reg, start, tl.size(), tl.data(), data.data());
+    pub_head.store(reg.head, memory_order_relaxed);
+    pub_et.store(reg.et, memory_order_relaxed);
+    low_idx.store(reg.head + 1, memory_order_relaxed);
+    rel_et.store(start, memory_order_relaxed);
+}
+
+bool ConcurrentRegion::has_room(size_t n) const
+{
+    // A published trailing gap is read from the slot after the head until
+    // the consumer releases its end time
+    if (reg.et > data_et && rel_et.load(memory_order_acquire) < reg.et) { return false; }
+
+    // Events take the slots after the head, including gaps before them
+    auto last = reg.head + static_cast<idx_t>(n);
+    return last - low_idx.load(memory_order_acquire) < static_cast<idx_t>(tl.size());
+}
+
+void ConcurrentRegion::publish()
+{
+    pub_head.store(reg.head, memory_order_release);
+    pub_et.store(reg.et, memory_order_release);
+}
+
+bool ConcurrentRegion::TryPush(ts_t st, ts_t et, const char* payload)
+{
+    if (st < reg.et || et <= st) {
+        throw std::runtime_error("Events must be ordered and non-empty");
+    }
+    if (!has_room(1)) { return false; }
+
+    if (st > reg.et) {
+        commit_null(&reg, st);
+    }
+    commit_data(&reg, et);
+    memcpy(fetch(&reg, et, get_end_idx(&reg), bytes), payload, bytes);
+    data_et = et;
+    publish();
+    return true;
+}
+
+bool ConcurrentRegion::TryPush(const ival_t* tl, const char* data, size_t n)
+{
+    auto et = reg.et;
+    for (size_t j = 0; j < n; j++) {
+        if (tl[j].t < et || tl[j].d == 0) {
+            throw std::runtime_error("Events must be ordered and non-empty");
+        }
+        et = tl[j].t + tl[j].d;
+    }
+    if (!has_room(n)) { return false; }
+
+    commit_batch(&reg, tl, data, bytes, n);
+    data_et = reg.et;
+    publish();
+    return true;
+}
+
+void ConcurrentRegion::Push(ts_t st, ts_t et, const char* payload)
+{
+    while (!TryPush(st, et, payload)) {
+        std::this_thread::yield();
+    }
+}
+
+void ConcurrentRegion::Push(const ival_t* tl, const char* data, size_t n)
+{
+    if (n > this->tl.size()) {
+        throw std::runtime_error("Batch does not fit in the region");
+    }
+    while (!TryPush(tl, data, n)) {
+        std::this_thread::yield();
+    }
+}
+
+bool ConcurrentRegion::TryAdvance(ts_t t)
+{
+    if (t < reg.et) {
+        throw std::runtime_error("Region is already past the time");
+    }
+    if (t == reg.et) { return true; }
+
+    // The gap is recorded in the slot after the head
+    if (!has_room(1)) { return false; }
+
+    commit_null(&reg, t);
+    publish();
+    return true;
+}
+
+void ConcurrentRegion::Advance(ts_t t)
+{
+    while (!TryAdvance(t)) {
+        std::this_thread::yield();
+    }
+}
+
+region_t* ConcurrentRegion::Snapshot(region_t* snap) const
+{
+    // The end time is read first, so the head covers at least its events
+    auto et = pub_et.load(memory_order_acquire);
+    auto head = pub_head.load(memory_order_acquire);
+    auto low = low_idx.load(memory_order_relaxed);
+
+    snap->st = low_time;
+    snap->et = et;
+    snap->head = head;
+    snap->count = head - low + 1;
+    snap->mask = reg.mask;
+    snap->tl = const_cast<ival_t*>(tl.data());
+    snap->data = const_cast<char*>(data.data());
+    return snap;
+}
+
+void ConcurrentRegion::Release(ts_t t)
+{
+    if (t > Watermark()) {
+        throw std::runtime_error("Released time is beyond the watermark");
+    }
+    rel_et.store(t, memory_order_release);
+    if (t - static_cast<ts_t>(lookback) <= low_time) { return; }
+
+    // Keep the events that end within the lookback of `t`
+    region_t snap;
+    Snapshot(&snap);
+    low_time = t - lookback;
+    auto low = advance(&snap, low_idx.load(memory_order_relaxed), low_time);
+    low_idx.store(low, memory_order_release);
+}
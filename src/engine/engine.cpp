@@ -1,62 +1,553 @@
+#include <chrono>
+
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Passes/PassBuilder.h"
 #include "llvm/ExecutionEngine/Orc/ExecutorProcessControl.h"
+#include "llvm/Transforms/IPO/AlwaysInliner.h"
 
 #include "tilt/engine/engine.h"
+#include "tilt/pass/hasher.h"
+#include "tilt/pass/codegen/loopgen.h"
+#include "tilt/pass/codegen/llvmgen.h"
+#include "tilt/pass/codegen/pool.h"
 
 using namespace tilt;
 using namespace std::placeholders;
+using namespace std::chrono;
+
+static double elapsed_ms(high_resolution_clock::time_point start)
+{
+    return duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+}
+
+bool EngineOptions::DefaultVerify()
+{
+#ifdef NDEBUG
+    return false;
+#else
+    return true;
+#endif
+}
+
+ExecEngine::~ExecEngine()
+{
+    if (worker.joinable()) {
+        {
+            lock_guard<mutex> lock(job_mtx);
+            stop_worker = true;
+        }
+        job_cv.notify_all();
+        worker.join();
+    }
+
+    // Frees the code of all loops and deregisters their unwind tables. Tables
+    // left registered would point into freed memory and break exceptions.
+    if (auto err = es->endSession()) {
+        consumeError(std::move(err));
+    }
+}
+
+void ExecEngine::register_runtime()
+{
+    // Runtime functions that are not linked from the vinstr bitcode
+    SymbolMap syms;
+    auto add = [&](StringRef name, void* fn) {
+        syms[mangler(name)] = JITEvaluatedSymbol(pointerToJITTargetAddress(fn), JITSymbolFlags::Exported);
+    };
+    add("pool_borrow", reinterpret_cast<void*>(&pool_borrow));
+    add("pool_mark", reinterpret_cast<void*>(&pool_mark));
+    add("pool_release", reinterpret_cast<void*>(&pool_release));
+
+    cantFail(jd.define(absoluteSymbols(syms)));
+    cantFail(baseline_jd.define(absoluteSymbols(syms)));
+}
+
+void ExecEngine::register_listeners()
+{
+    if (perf_listener) {
+        linker.registerJITEventListener(*perf_listener);
+    }
+    if (opts.perf_jitdump) {
+        auto listener = JITEventListener::createPerfJITEventListener();
+        if (!listener) {
+            throw std::runtime_error("perf jitdump requires LLVM built with LLVM_USE_PERF");
+        }
+        linker.registerJITEventListener(*listener);
+    }
+    if (opts.gdb) {
+        linker.registerJITEventListener(*JITEventListener::createGDBRegistrationListener());
+    }
+}
 
 ExecEngine* ExecEngine::Get()
 {
     static unique_ptr<ExecEngine> engine;
 
     if (!engine) {
-        InitializeNativeTarget();
-        InitializeNativeTargetAsmPrinter();
+        engine = Create();
+    }
 
-        auto jtmb = cantFail(JITTargetMachineBuilder::detectHost());
-        auto dl = cantFail(jtmb.getDefaultDataLayoutForTarget());
+    return engine.get();
+}
 
-        engine = make_unique<ExecEngine>(std::move(jtmb), std::move(dl));
+unique_ptr<ExecEngine> ExecEngine::Create(EngineOptions opts)
+{
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+
+    auto jtmb = cantFail(JITTargetMachineBuilder::detectHost());
+    if (!opts.cpu.empty()) {
+        jtmb.setCPU(opts.cpu);
+    }
+    if (!opts.features.empty()) {
+        jtmb.getFeatures() = SubtargetFeatures(opts.features);
     }
+    switch (opts.opt_level) {
+        case 0: jtmb.setCodeGenOptLevel(CodeGenOpt::None); break;
+        case 1: jtmb.setCodeGenOptLevel(CodeGenOpt::Less); break;
+        case 2: jtmb.setCodeGenOptLevel(CodeGenOpt::Default); break;
+        default: jtmb.setCodeGenOptLevel(CodeGenOpt::Aggressive); break;
+    }
+    auto dl = cantFail(jtmb.getDefaultDataLayoutForTarget());
 
-    return engine.get();
+    return make_unique<ExecEngine>(std::move(jtmb), std::move(dl), opts);
+}
+
+void ExecEngine::AddModule(unique_ptr<Module> m) { add_module(std::move(m), ctx, jd.getDefaultResourceTracker()); }
+
+void ExecEngine::add_module(unique_ptr<Module> m, ThreadSafeContext tsctx, ResourceTrackerSP rt)
+{
+    if (opts.verify) {
+        string errs;
+        raw_string_ostream r(errs);
+        if (verifyModule(*m, &r)) {
+            throw CompileError(m->getSourceFileName(), "verify", r.str());
+        }
+    }
+
+    auto name = m->getSourceFileName();
+    if (auto err = optimizer.add(rt, ThreadSafeModule(std::move(m), tsctx))) {
+        throw CompileError(name, "add", toString(std::move(err)));
+    }
+}
+
+tilt::Loop ExecEngine::AddQuery(const Sym sym, const Op op, bool bounded)
+{
+    return AddQuery(sym, op, bounded, opts.fast_math);
+}
+
+tilt::Loop ExecEngine::AddQuery(const Sym sym, const Op op, bool bounded, bool fast_math)
+{
+    auto start = high_resolution_clock::now();
+    auto loop = LoopGen::Build(sym, op.get(), bounded);
+    record(loop->get_name(), &CompileStats::loopgen, elapsed_ms(start));
+
+    AddLoop(loop, fast_math);
+    return loop;
+}
+
+CompileStats ExecEngine::GetStats(const string& name)
+{
+    lock_guard<mutex> lock(query_mtx);
+    auto it = queries.find(name);
+    if (it == queries.end()) {
+        throw std::runtime_error("Unknown query: " + name);
+    }
+    return it->second.stats;
+}
+
+void ExecEngine::record(const string& name, double CompileStats::* phase, double time)
+{
+    lock_guard<mutex> lock(query_mtx);
+    queries[name].stats.*phase += time;
+}
+
+void ExecEngine::AddLoop(const Loop loop) { add_loop(loop, ctx, opts.fast_math); }
+
+void ExecEngine::AddLoop(const Loop loop, bool fast_math) { add_loop(loop, ctx, fast_math); }
+
+void ExecEngine::add_loop(const Loop loop, ThreadSafeContext tsctx, bool fast_math)
+{
+    auto rt = track(jd, loop->get_name());
+
+    string key;
+    if (cache.Enabled()) {
+        key = CacheKey(loop, fast_math);
+        if (auto obj = cache.Load(key)) {
+            if (auto err = linker.add(rt, std::move(obj))) {
+                throw CompileError(loop->get_name(), "link", toString(std::move(err)));
+            }
+            lock_guard<mutex> lock(query_mtx);
+            queries[loop->get_name()].stats.cached = true;
+            return;
+        }
+    }
+
+    auto lock = tsctx.getLock();
+    auto start = high_resolution_clock::now();
+    auto m = LLVMGen::Build(loop, *tsctx.getContext(), opts.layout());
+    record(loop->get_name(), &CompileStats::llvmgen, elapsed_ms(start));
+    if (fast_math) {
+        SetFastMath(*m);
+    }
+    if (!key.empty()) {
+        // The compiler stores the object under the module identifier
+        m->setModuleIdentifier(key);
+    }
+    add_module(std::move(m), tsctx, rt);
+}
+
+vector<intptr_t> ExecEngine::AddLoops(const vector<Loop>& loops, unsigned threads)
+{
+    return AddLoops(loops, threads, opts.fast_math);
+}
+
+vector<intptr_t> ExecEngine::AddLoops(const vector<Loop>& loops, unsigned threads, bool fast_math)
+{
+    if (threads == 0) {
+        threads = max(thread::hardware_concurrency(), 1u);
+    }
+    threads = min<size_t>(threads, loops.size());
+
+    // Each compile thread generates its modules in its own context and
+    // looks them up itself. Lookups materialize on the calling thread, so
+    // optimization and codegen of independent loops run concurrently.
+    vector<intptr_t> addrs(loops.size());
+    atomic<size_t> next(0);
+    vector<thread> pool;
+    for (unsigned i = 0; i < threads; i++) {
+        pool.emplace_back([this, &loops, &addrs, &next, fast_math](ThreadSafeContext tsctx) {
+            for (auto j = next++; j < loops.size(); j = next++) {
+                add_loop(loops[j], tsctx, fast_math);
+                addrs[j] = Lookup(loops[j]->get_name());
+            }
+        }, get_compile_ctx(i));
+    }
+    for (auto& t : pool) {
+        t.join();
+    }
+
+    return addrs;
+}
+
+ThreadSafeContext ExecEngine::get_compile_ctx(size_t i)
+{
+    lock_guard<mutex> lock(ctx_mtx);
+    while (compile_ctxs.size() <= i) {
+        compile_ctxs.emplace_back(make_unique<LLVMContext>());
+    }
+    return compile_ctxs[i];
 }
 
-void ExecEngine::AddModule(unique_ptr<Module> m)
+ResourceTrackerSP ExecEngine::track(JITDylib& dylib, const string& name)
 {
-    raw_fd_ostream r(fileno(stdout), false);
-    verifyModule(*m, &r);
+    auto rt = dylib.createResourceTracker();
+    lock_guard<mutex> lock(query_mtx);
+    queries[name].trackers.push_back(rt);
+    return rt;
+}
+
+void ExecEngine::RemoveQuery(const string& name)
+{
+    // The optimized tier may still be compiling into one of the trackers
+    shared_future<void> pending;
+    {
+        lock_guard<mutex> lock(query_mtx);
+        auto it = queries.find(name);
+        if (it == queries.end()) {
+            throw std::runtime_error("Unknown query: " + name);
+        }
+        pending = it->second.pending;
+    }
+    if (pending.valid()) {
+        pending.wait();
+    }
 
-    cantFail(optimizer.add(jd, ThreadSafeModule(std::move(m), ctx)));
+    QueryResources res;
+    {
+        lock_guard<mutex> lock(query_mtx);
+        res = std::move(queries[name]);
+        queries.erase(name);
+    }
+    for (auto& rt : res.trackers) {
+        cantFail(rt->remove());
+    }
+}
+
+void ExecEngine::SetCacheDir(string dir, size_t max_size) { cache.SetDir(dir, max_size); }
+
+string ExecEngine::CacheKey(const Loop loop) { return CacheKey(loop, opts.fast_math); }
+
+string ExecEngine::CacheKey(const Loop loop, bool fast_math)
+{
+    auto id = IRHasher::Build(loop) + target + (fast_math ? ";fast-math" : "");
+    return ObjCache::MakeKey(IRHasher::Hash(id));
 }
 
 LLVMContext& ExecEngine::GetCtx() { return *ctx.getContext(); }
 
 intptr_t ExecEngine::Lookup(StringRef name)
 {
-    auto fn_sym = cantFail(es->lookup({ &jd }, mangler(name.str())));
-    return (intptr_t) fn_sym.getAddress();
+    // The first lookup of a query materializes it. Whatever is not spent
+    // in optimization and codegen is linking.
+    auto start = high_resolution_clock::now();
+    auto addr = lookup(jd, name);
+    auto time = elapsed_ms(start);
+
+    lock_guard<mutex> lock(query_mtx);
+    auto it = queries.find(name.str());
+    if (it != queries.end() && !it->second.stats.linked) {
+        auto& stats = it->second.stats;
+        stats.link = max(time - stats.optimize - stats.codegen, 0.0);
+        stats.linked = true;
+    }
+    return addr;
+}
+
+intptr_t ExecEngine::lookup(JITDylib& dylib, StringRef name)
+{
+    auto fn_sym = es->lookup({ &dylib }, mangler(name.str()));
+    if (!fn_sym) {
+        throw CompileError(name.str(), "link", toString(fn_sym.takeError()));
+    }
+    return (intptr_t) fn_sym->getAddress();
+}
+
+shared_ptr<TieredQuery> ExecEngine::AddTieredLoop(const Loop loop) { return AddTieredLoop(loop, opts.fast_math); }
+
+shared_ptr<TieredQuery> ExecEngine::AddTieredLoop(const Loop loop, bool fast_math)
+{
+    auto query = make_shared<TieredQuery>();
+    auto rt = track(jd, loop->get_name());
+
+    // Skip the baseline if the optimized object is already cached
+    if (cache.Enabled()) {
+        if (auto obj = cache.Load(CacheKey(loop, fast_math))) {
+            if (auto err = linker.add(rt, std::move(obj))) {
+                throw CompileError(loop->get_name(), "link", toString(std::move(err)));
+            }
+            query->addr.store(Lookup(loop->get_name()), memory_order_release);
+            query->tier.store(Tier::OPTIMIZED, memory_order_release);
+            query->ready.set_value();
+            return query;
+        }
+    }
+
+    auto start = high_resolution_clock::now();
+    {
+        auto lock = ctx.getLock();
+        auto m = LLVMGen::Build(loop, GetCtx(), opts.layout());
+        if (fast_math) {
+            SetFastMath(*m);
+        }
+        auto baseline_rt = track(baseline_jd, loop->get_name());
+        if (auto err = baseline_optimizer.add(baseline_rt, ThreadSafeModule(std::move(m), ctx))) {
+            throw CompileError(loop->get_name(), "add", toString(std::move(err)));
+        }
+    }
+    query->addr.store(lookup(baseline_jd, loop->get_name()), memory_order_release);
+    query->baseline_time = elapsed_ms(start);
+
+    {
+        lock_guard<mutex> lock(query_mtx);
+        queries[loop->get_name()].pending = query->done;
+    }
+    submit([this, loop, fast_math, query, rt]() { optimize_tier(loop, fast_math, query, rt); });
+    return query;
+}
+
+void ExecEngine::optimize_tier(const Loop loop, bool fast_math, shared_ptr<TieredQuery> query, ResourceTrackerSP rt)
+{
+    // Optimized tiers are generated in their own context, so that they
+    // do not contend with foreground compilation on `ctx`
+    auto start = high_resolution_clock::now();
+    intptr_t addr;
+    try {
+        {
+            auto lock = opt_ctx.getLock();
+            auto m = LLVMGen::Build(loop, *opt_ctx.getContext(), opts.layout());
+            if (fast_math) {
+                SetFastMath(*m);
+            }
+            if (cache.Enabled()) {
+                m->setModuleIdentifier(CacheKey(loop, fast_math));
+            }
+            if (auto err = optimizer.add(rt, ThreadSafeModule(std::move(m), opt_ctx))) {
+                throw CompileError(loop->get_name(), "add", toString(std::move(err)));
+            }
+        }
+        addr = Lookup(loop->get_name());
+    } catch (...) {
+        // The query keeps running the baseline loop
+        query->ready.set_exception(current_exception());
+        return;
+    }
+    query->optimized_time = elapsed_ms(start);
+
+    query->addr.store(addr, memory_order_release);
+    query->tier.store(Tier::OPTIMIZED, memory_order_release);
+    query->ready.set_value();
+}
+
+void ExecEngine::submit(function<void()> job)
+{
+    {
+        lock_guard<mutex> lock(job_mtx);
+        jobs.push_back(std::move(job));
+        if (!worker.joinable()) {
+            worker = thread(&ExecEngine::run_worker, this);
+        }
+    }
+    job_cv.notify_one();
+}
+
+void ExecEngine::run_worker()
+{
+    while (true) {
+        function<void()> job;
+        {
+            unique_lock<mutex> lock(job_mtx);
+            job_cv.wait(lock, [this]() { return stop_worker || !jobs.empty(); });
+            if (jobs.empty()) { return; }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
 }
 
 Expected<ThreadSafeModule> ExecEngine::optimize_module(ThreadSafeModule tsm, const MaterializationResponsibility &r)
 {
-    tsm.withModuleDo([](Module &m) {
-        unsigned opt_level = 3;
-        unsigned opt_size = 0;
+    // Target machines are not thread-safe, so every module gets its own
+    auto tm = jtmb.createTargetMachine();
+    if (!tm) {
+        return tm.takeError();
+    }
+
+    tsm.withModuleDo([this, &tm](Module &m) {
+        auto start = high_resolution_clock::now();
+        OptimizeModule(m, **tm, opts);
+        record(m.getSourceFileName(), &CompileStats::optimize, elapsed_ms(start));
+    });
+    return std::move(tsm);
+}
+
+void ExecEngine::OptimizeModule(Module& m, TargetMachine& tm, const EngineOptions& opts)
+{
+    // Let the IR passes see the target, in particular the vector
+    // registers available to the vectorizers
+    for (auto& fn : m.functions()) {
+        if (fn.isDeclaration()) { continue; }
+        fn.addFnAttr("target-cpu", tm.getTargetCPU());
+        fn.addFnAttr("target-features", tm.getTargetFeatureString());
+
+        // Profilers unwind call stacks through frame pointers
+        if (opts.perf_map || opts.perf_jitdump) {
+            fn.addFnAttr("frame-pointer", "all");
+        }
+    }
+
+    if (opts.new_pm) {
+        PipelineTuningOptions pto;
+        pto.LoopVectorization = opts.vectorize;
+        pto.SLPVectorization = opts.vectorize;
+        pto.LoopUnrolling = opts.unroll;
+
+        LoopAnalysisManager lam;
+        FunctionAnalysisManager fam;
+        CGSCCAnalysisManager cgam;
+        ModuleAnalysisManager mam;
+
+        PassBuilder pb(&tm, pto);
+        pb.registerModuleAnalyses(mam);
+        pb.registerCGSCCAnalyses(cgam);
+        pb.registerFunctionAnalyses(fam);
+        pb.registerLoopAnalyses(lam);
+        pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+        static const OptimizationLevel levels[] = {
+            OptimizationLevel::O0, OptimizationLevel::O1, OptimizationLevel::O2, OptimizationLevel::O3,
+        };
+        auto level = levels[min(opts.opt_level, 3u)];
+        auto mpm = (level == OptimizationLevel::O0) ?
+            pb.buildO0DefaultPipeline(level) : pb.buildPerModuleDefaultPipeline(level);
+        mpm.run(m, mam);
+        return;
+    }
 
-        llvm::PassManagerBuilder builder;
-        builder.OptLevel = opt_level;
-        builder.Inliner = createFunctionInliningPass(opt_level, opt_size, false);
+    unsigned opt_level = min(opts.opt_level, 3u);
+    unsigned opt_size = 0;
 
+    llvm::PassManagerBuilder builder;
+    builder.OptLevel = opt_level;
+    builder.Inliner = createFunctionInliningPass(opt_level, opt_size, false);
+    builder.LoopVectorize = opts.vectorize && opt_level > 1;
+    builder.SLPVectorize = opts.vectorize && opt_level > 1;
+    builder.DisableUnrollLoops = !opts.unroll;
+    tm.adjustPassManager(builder);
+
+    llvm::legacy::PassManager mpm;
+    mpm.add(createTargetTransformInfoWrapperPass(tm.getTargetIRAnalysis()));
+    builder.populateModulePassManager(mpm);
+    mpm.run(m);
+}
+
+void ExecEngine::SetFastMath(Module& m)
+{
+    FastMathFlags fmf;
+    fmf.setFast();
+
+    for (auto& fn : m.functions()) {
+        if (fn.isDeclaration()) { continue; }
+        fn.addFnAttr("unsafe-fp-math", "true");
+        fn.addFnAttr("no-nans-fp-math", "true");
+        fn.addFnAttr("no-infs-fp-math", "true");
+        fn.addFnAttr("no-signed-zeros-fp-math", "true");
+        for (auto& inst : instructions(fn)) {
+            if (isa<FPMathOperator>(inst)) {
+                inst.setFastMathFlags(fmf);
+            }
+        }
+    }
+}
+
+Expected<unique_ptr<MemoryBuffer>> TimedIRCompiler::operator()(Module& m)
+{
+    auto start = high_resolution_clock::now();
+    auto obj = (*compiler)(m);
+    report(m, elapsed_ms(start));
+    return obj;
+}
+
+Expected<ThreadSafeModule> ExecEngine::optimize_baseline(ThreadSafeModule tsm, const MaterializationResponsibility &r)
+{
+    // Baseline tier only inlines the vinstrs, which are marked always_inline
+    tsm.withModuleDo([](Module &m) {
         llvm::legacy::PassManager mpm;
-        builder.populateModulePassManager(mpm);
+        mpm.add(createAlwaysInlinerLegacyPass());
         mpm.run(m);
     });
 
     return std::move(tsm);
 }
 
+JITTargetMachineBuilder ExecEngine::get_baseline_jtmb(JITTargetMachineBuilder jtmb)
+{
+    jtmb.setCodeGenOptLevel(CodeGenOpt::None);
+    return jtmb;
+}
+
+string ExecEngine::get_target_id(const JITTargetMachineBuilder& jtmb, const EngineOptions& opts)
+{
+    return jtmb.getTargetTriple().str() + ";" + jtmb.getCPU() + ";" + jtmb.getFeatures().getString()
+        + ";O" + to_string(opts.opt_level) + (opts.new_pm ? ";new-pm" : "")
+        + (opts.vectorize ? "" : ";no-vectorize") + (opts.unroll ? "" : ";no-unroll")
+        + (opts.columnar ? ";columnar" : "") + (opts.compact_tl ? ";compact-tl" : "");
+}
+
 unique_ptr<ExecutionSession> ExecEngine::createExecutionSession() {
     unique_ptr<SelfExecutorProcessControl> epc = llvm::cantFail(SelfExecutorProcessControl::Create());
     return std::make_unique<ExecutionSession>(std::move(epc));
@@ -0,0 +1,164 @@
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tilt/engine/eventlog.h"
+#include "tilt/pass/codegen/vinstr.h"
+
+using namespace tilt;
+
+// Sections of a log start at page boundaries, so that they can be mapped
+static constexpr uint64_t LOG_ALIGN = 4096;
+
+static uint64_t log_align(uint64_t off) { return (off + LOG_ALIGN - 1) / LOG_ALIGN * LOG_ALIGN; }
+
+// Whether `size` bytes at `off` lie within a file of `len` bytes, without
+// overflowing on offsets read from a corrupt file
+static bool in_file(uint64_t off, uint64_t size, uint64_t len) { return off <= len && size <= len - off; }
+
+EventLogWriter::EventLogWriter(string path, uint32_t bytes, ts_t start) :
+    path(path), data_path(path + ".data"), header()
+{
+    memcpy(header.magic, EventLogHeader::MAGIC, sizeof(header.magic));
+    header.version = EventLogHeader::VERSION;
+    header.bytes = bytes;
+    header.st = start;
+    header.et = start;
+    header.tl_offset = LOG_ALIGN;
+
+    tl_file = fopen(path.c_str(), "wb");
+    data_file = fopen(data_path.c_str(), "wb+");
+    if (!tl_file || !data_file) {
+        throw std::runtime_error("Failed to create event log " + path);
+    }
+    fseek(tl_file, header.tl_offset, SEEK_SET);
+}
+
+EventLogWriter::~EventLogWriter()
+{
+    try {
+        Close();
+    } catch (const std::exception&) {
+    }
+}
+
+void EventLogWriter::Append(ts_t st, ts_t et, const char* payload)
+{
+    ival_t ivl = { st, static_cast<dur_t>(et - st) };
+    Append(&ivl, payload, 1);
+}
+
+void EventLogWriter::Append(const ival_t* tl, const char* data, size_t n)
+{
+    if (!tl_file) {
+        throw std::runtime_error("Event log " + path + " is closed");
+    }
+
+    auto et = header.et;
+    for (size_t i = 0; i < n; i++) {
+        if (tl[i].t < et || tl[i].d == 0) {
+            throw std::runtime_error("Events must be ordered and non-empty");
+        }
+        et = tl[i].t + tl[i].d;
+    }
+
+    if (fwrite(tl, sizeof(ival_t), n, tl_file) != n
+        || fwrite(data, header.bytes, n, data_file) != n) {
+        throw std::runtime_error("Failed to write event log " + path);
+    }
+    header.count += n;
+    header.et = et;
+}
+
+void EventLogWriter::Close()
+{
+    if (!tl_file) { return; }
+
+    // The timeline ends like a region after `commit_null`
+    ival_t end = { header.et, 0 };
+    fwrite(&end, sizeof(ival_t), 1, tl_file);
+
+    // Payloads follow the timeline at the next page
+    header.data_offset = log_align(header.tl_offset + (header.count + 1) * sizeof(ival_t));
+    fseek(tl_file, header.data_offset, SEEK_SET);
+    rewind(data_file);
+    vector<char> buf(1 << 20);
+    size_t n;
+    bool ok = true;
+    while ((n = fread(buf.data(), 1, buf.size(), data_file)) > 0) {
+        ok &= (fwrite(buf.data(), 1, n, tl_file) == n);
+    }
+    ok &= !ferror(data_file);
+
+    fseek(tl_file, 0, SEEK_SET);
+    ok &= (fwrite(&header, sizeof(header), 1, tl_file) == 1);
+    ok &= (fclose(tl_file) == 0);
+    fclose(data_file);
+    remove(data_path.c_str());
+    tl_file = nullptr;
+    data_file = nullptr;
+
+    if (!ok) {
+        throw std::runtime_error("Failed to write event log " + path);
+    }
+}
+
+EventLog::EventLog(string path, RegionLayout layout) : addr(nullptr), len(0)
+{
+    check_default_layout(layout, "EventLog");
+
+    auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open event log " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(header))) {
+        len = st.st_size;
+        auto ptr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+        addr = (ptr == MAP_FAILED) ? nullptr : static_cast<char*>(ptr);
+    }
+    close(fd);
+    if (!addr) {
+        throw std::runtime_error("Failed to map event log " + path);
+    }
+
+    memcpy(&header, addr, sizeof(header));
+    string err;
+    if (memcmp(header.magic, EventLogHeader::MAGIC, sizeof(header.magic))) {
+        err = "not an event log";
+    } else if (header.version != EventLogHeader::VERSION) {
+        err = "unsupported version " + to_string(header.version);
+    } else if (header.count >= (1ull << 31)) {
+        err = "too many events";
+    } else if (header.tl_offset % LOG_ALIGN || header.data_offset % LOG_ALIGN) {
+        // Also keeps the timeline aligned for `ival_t`
+        err = "misaligned section";
+    } else if (!in_file(header.tl_offset, (header.count + 1) * sizeof(ival_t), len)
+        || !in_file(header.data_offset, header.count * header.bytes, len)) {
+        err = "truncated file";
+    }
+    if (!err.empty()) {
+        munmap(addr, len);
+        throw std::runtime_error("Invalid event log " + path + ": " + err);
+    }
+
+    // Loops scan inputs front to back
+    madvise(addr, len, MADV_SEQUENTIAL);
+
+    // The region covers the whole log and is read-only
+    reg.st = header.st;
+    reg.et = header.et;
+    reg.head = static_cast<idx_t>(header.count) - 1;
+    reg.count = header.count;
+    reg.mask = get_buf_size(header.count) - 1;
+    reg.tl = reinterpret_cast<ival_t*>(addr + header.tl_offset);
+    reg.data = addr + header.data_offset;
+}
+
+EventLog::~EventLog() { munmap(addr, len); }
@@ -0,0 +1,123 @@
+#include <cstring>
+
+#include "tilt/base/log.h"
+#include "tilt/engine/ingest.h"
+
+namespace {
+
+// Copies `n` elements of `bytes` bytes to the ring buffer `buf` starting
+// at slot `slot`, in at most two segments
+void copy_ring(char* buf, uint32_t capacity, uint32_t slot, const char* src, uint32_t bytes, uint32_t n)
+{
+    auto first = (n < capacity - slot) ? n : capacity - slot;
+    memcpy(buf + static_cast<size_t>(slot) * bytes, src, static_cast<size_t>(first) * bytes);
+    memcpy(buf, src + static_cast<size_t>(first) * bytes, static_cast<size_t>(n - first) * bytes);
+}
+
+// Number of leading events of a batch of `n` that would be overwritten
+// within the batch itself
+uint32_t get_skip(const region_t* reg, uint32_t n)
+{
+    auto capacity = reg->mask + 1;
+    return (n > capacity) ? n - capacity : 0;
+}
+
+void copy_tl(region_t* reg, uint32_t slot, const ival_t* tl, uint32_t n)
+{
+    copy_ring(reinterpret_cast<char*>(reg->tl), reg->mask + 1, slot,
+        reinterpret_cast<const char*>(tl), sizeof(ival_t), n);
+}
+
+// Compact timelines keep the low 32 bits of the start times
+void copy_tl_compact(region_t* reg, uint32_t slot, const ival_t* tl, uint32_t n)
+{
+    auto ctl = reinterpret_cast<cival_t*>(reg->tl);
+    for (uint32_t i = 0; i < n; i++) {
+        ctl[(slot + i) & reg->mask] = { static_cast<uint32_t>(tl[i].t), tl[i].d };
+    }
+}
+
+template<void (*CopyTl)(region_t*, uint32_t, const ival_t*, uint32_t)>
+region_t* commit_col_batch_tl(region_t* reg, const ival_t* tl, const char* const* cols, const uint32_t* offs,
+                              const uint32_t* sizes, uint32_t ncols, uint32_t n)
+{
+    if (n == 0) { return reg; }
+
+    auto capacity = reg->mask + 1;
+    auto skip = get_skip(reg, n);
+    auto head = reg->head + skip;
+    auto slot = static_cast<uint32_t>((head + 1) & reg->mask);
+    auto len = n - skip;
+
+    CopyTl(reg, slot, tl + skip, len);
+    for (uint32_t c = 0; c < ncols; c++) {
+        auto col = reg->data + static_cast<size_t>(offs[c]) * capacity;
+        copy_ring(col, capacity, slot, cols[c] + static_cast<size_t>(skip) * sizes[c], sizes[c], len);
+    }
+
+    reg->head += n;
+    reg->count += n;
+    reg->et = tl[n - 1].t + tl[n - 1].d;
+    return reg;
+}
+
+}  // namespace
+
+namespace tilt {
+extern "C" {
+
+region_t* commit_col_batch(region_t* reg, const ival_t* tl, const char* const* cols, const uint32_t* offs,
+                           const uint32_t* sizes, uint32_t ncols, uint32_t n)
+{
+    return commit_col_batch_tl<copy_tl>(reg, tl, cols, offs, sizes, ncols, n);
+}
+
+region_t* commit_col_batch_compact(region_t* reg, const ival_t* tl, const char* const* cols, const uint32_t* offs,
+                                   const uint32_t* sizes, uint32_t ncols, uint32_t n)
+{
+    return commit_col_batch_tl<copy_tl_compact>(reg, tl, cols, offs, sizes, ncols, n);
+}
+
+region_t* commit_batch(region_t* reg, const ival_t* tl, const char* data, uint32_t bytes, uint32_t n)
+{
+    // Rows are a single column holding the whole payload
+    uint32_t off = 0;
+    return commit_col_batch(reg, tl, &data, &off, &bytes, 1, n);
+}
+
+region_t* commit_batch_compact(region_t* reg, const ival_t* tl, const char* data, uint32_t bytes, uint32_t n)
+{
+    uint32_t off = 0;
+    return commit_col_batch_compact(reg, tl, &data, &off, &bytes, 1, n);
+}
+
+region_t* init_regular_region(region_t* reg, ts_t offset, dur_t period, ts_t t, uint32_t size, char* data)
+{
+    ASSERT((t - offset) % period == 0);
+
+    reg->st = t;
+    reg->et = t;
+    reg->head = (t - offset) / period - 1;
+    reg->count = 0;
+    reg->mask = size - 1;
+    reg->tl = nullptr;
+    reg->data = data;
+    return reg;
+}
+
+region_t* commit_regular_batch(region_t* reg, dur_t period, const char* data, uint32_t bytes, uint32_t n)
+{
+    if (n == 0) { return reg; }
+
+    auto skip = get_skip(reg, n);
+    auto slot = static_cast<uint32_t>((reg->head + skip + 1) & reg->mask);
+    copy_ring(reg->data, reg->mask + 1, slot, data + static_cast<size_t>(skip) * bytes, bytes, n - skip);
+
+    reg->head += n;
+    reg->count += n;
+    reg->et += static_cast<ts_t>(n) * period;
+    return reg;
+}
+
+}  // extern "C"
+}  // namespace tilt
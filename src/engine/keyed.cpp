@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "tilt/engine/keyed.h"
+
+using namespace tilt;
+
+WorkStealingPool::WorkStealingPool(unsigned threads) : pending(0), epoch(0), stop(false)
+{
+    if (threads == 0) {
+        threads = max(thread::hardware_concurrency(), 1u);
+    }
+
+    for (unsigned i = 0; i < threads; i++) {
+        workers.push_back(make_unique<Worker>());
+    }
+    // Worker 0 is the thread calling `Run`
+    for (unsigned i = 1; i < threads; i++) {
+        this->threads.emplace_back(&WorkStealingPool::work, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        lock_guard<mutex> lock(mtx);
+        stop = true;
+    }
+    start_cv.notify_all();
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void WorkStealingPool::Run(const vector<function<void()>>& tasks)
+{
+    if (tasks.empty()) { return; }
+
+    pending += tasks.size();
+    for (size_t i = 0; i < tasks.size(); i++) {
+        auto& w = *workers[i % workers.size()];
+        lock_guard<mutex> lock(w.mtx);
+        w.tasks.push_back(&tasks[i]);
+    }
+    {
+        lock_guard<mutex> lock(mtx);
+        epoch++;
+    }
+    start_cv.notify_all();
+
+    drain(0);
+    unique_lock<mutex> lock(mtx);
+    done_cv.wait(lock, [this]() { return pending == 0; });
+    if (error) {
+        rethrow_exception(exchange(error, nullptr));
+    }
+}
+
+void WorkStealingPool::work(unsigned i)
+{
+    uint64_t seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(mtx);
+            start_cv.wait(lock, [this, seen]() { return stop || epoch != seen; });
+            if (stop) { return; }
+            seen = epoch;
+        }
+        drain(i);
+    }
+}
+
+void WorkStealingPool::drain(unsigned i)
+{
+    Task task;
+    while (take(i, task)) {
+        // Failed tasks count as done, so that `Run` returns
+        try {
+            (*task)();
+        } catch (...) {
+            lock_guard<mutex> lock(mtx);
+            if (!error) { error = current_exception(); }
+        }
+        if (--pending == 0) {
+            lock_guard<mutex> lock(mtx);
+            done_cv.notify_all();
+        }
+    }
+}
+
+bool WorkStealingPool::take(unsigned i, Task& task)
+{
+    {
+        auto& w = *workers[i];
+        lock_guard<mutex> lock(w.mtx);
+        if (!w.tasks.empty()) {
+            task = w.tasks.front();
+            w.tasks.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t j = 1; j < workers.size(); j++) {
+        auto& w = *workers[(i + j) % workers.size()];
+        lock_guard<mutex> lock(w.mtx);
+        if (!w.tasks.empty()) {
+            task = w.tasks.back();
+            w.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+KeyedExecutor::KeyedExecutor(intptr_t addr, uint32_t in_size, uint32_t out_size, Sink sink,
+                             ts_t chunk, size_t in_capacity, size_t in_lookback, size_t out_capacity,
+                             unsigned threads, ts_t start, RegionLayout layout) :
+    addr(addr), in_size(in_size), out_size(out_size), sink(sink), chunk(chunk),
+    in_capacity(in_capacity), in_lookback(in_lookback), out_capacity(out_capacity), t(start), pool(threads)
+{
+    check_default_layout(layout, "KeyedExecutor");
+}
+
+void KeyedExecutor::Push(uint64_t key, ts_t st, ts_t et, const char* payload)
+{
+    auto it = index.find(key);
+    if (it == index.end()) {
+        auto k = make_unique<Key>();
+        k->key = key;
+        k->pushed = 0;
+
+        // Outputs are collected by the worker running the key and merged
+        // after all keys are done
+        auto kp = k.get();
+        auto collect = [kp, this](const ival_t* tl, const char* data, size_t n) {
+            kp->out_tl.insert(kp->out_tl.end(), tl, tl + n);
+            kp->out_data.insert(kp->out_data.end(), data, data + n * out_size);
+            return n;
+        };
+        k->driver = make_unique<StreamDriver>(addr, vector<uint32_t>{in_size}, out_size,
+            StreamDriver::BatchSink(collect), chunk, in_capacity, in_lookback, out_capacity, t);
+
+        it = index.emplace(key, keys.size()).first;
+        keys.push_back(std::move(k));
+    }
+
+    auto& k = *keys[it->second];
+    k.driver->Push(0, st, et, payload);
+    k.pushed++;
+}
+
+ts_t KeyedExecutor::Run(ts_t end)
+{
+    if (end <= t) { return t; }
+
+    // Keys with the most new events go first, and idle workers steal the
+    // keys queued behind them
+    vector<Key*> order;
+    for (const auto& k : keys) {
+        order.push_back(k.get());
+    }
+    stable_sort(order.begin(), order.end(), [](const Key* a, const Key* b) { return a->pushed > b->pushed; });
+
+    vector<function<void()>> tasks;
+    for (auto k : order) {
+        tasks.emplace_back([k, end]() {
+            k->driver->Flush(end);
+            k->pushed = 0;
+        });
+    }
+    pool.Run(tasks);
+
+    t = end;
+    merge();
+    return t;
+}
+
+void KeyedExecutor::merge()
+{
+    // Heap of the next output of every key by start time and key order
+    typedef tuple<ts_t, size_t, size_t> Next;
+    priority_queue<Next, vector<Next>, greater<Next>> heap;
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (!keys[i]->out_tl.empty()) {
+            heap.emplace(keys[i]->out_tl[0].t, i, 0);
+        }
+    }
+
+    while (!heap.empty()) {
+        auto [_, i, j] = heap.top();
+        heap.pop();
+        auto& k = *keys[i];
+        sink(k.key, k.out_tl[j], k.out_data.data() + j * out_size);
+        if (++j < k.out_tl.size()) {
+            heap.emplace(k.out_tl[j].t, i, j);
+        }
+    }
+
+    for (auto& k : keys) {
+        k->out_tl.clear();
+        k->out_data.clear();
+    }
+}
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tilt/engine/parallel.h"
+#include "tilt/engine/ingest.h"
+#include "tilt/engine/stream.h"
+#include "tilt/pass/codegen/vinstr.h"
+
+using namespace tilt;
+
+namespace {
+
+// The first iteration of a loop starting at `t` is at `t + period`, where
+// points and windows on `in` read back to their offset. Nested operators on
+// `in` start one period before the outer iteration.
+int64_t get_lookback(const OpNode* op, const Sym& in)
+{
+    int64_t lookback = 0;
+    for (const auto& [_, expr] : op->syms) {
+        if (auto elem = dynamic_pointer_cast<Element>(expr)) {
+            if (elem->lstream == in) {
+                lookback = max(lookback, -elem->pt.offset - op->iter.period);
+            }
+        } else if (auto subls = dynamic_pointer_cast<SubLStream>(expr)) {
+            if (subls->lstream == in) {
+                lookback = max(lookback, -subls->win.start.offset - op->iter.period);
+            }
+        } else if (auto inner = dynamic_pointer_cast<OpNode>(expr)) {
+            if (find(inner->inputs.begin(), inner->inputs.end(), in) != inner->inputs.end()) {
+                lookback = max(lookback, get_lookback(inner.get(), in));
+            }
+        }
+    }
+    return lookback;
+}
+
+struct Chunk {
+    region_t reg;
+    vector<ival_t> tl;
+    vector<char> data;
+    bool done = false;
+};
+
+}  // namespace
+
+ParallelExecutor::ParallelExecutor(const Op op, intptr_t addr, uint32_t out_size, unsigned threads, ts_t chunk,
+                                   RegionLayout layout) :
+    op(op), addr(addr), out_size(out_size), threads(threads), chunk(chunk), lookback(Lookback(op.get()))
+{
+    check_default_layout(layout, "ParallelExecutor");
+    if (this->threads == 0) {
+        this->threads = max(thread::hardware_concurrency(), 1u);
+    }
+    if (chunk < 0 || chunk % op->iter.period != 0) {
+        throw std::runtime_error("Chunk must be a multiple of the operator period");
+    }
+}
+
+vector<int64_t> ParallelExecutor::Lookback(const OpNode* op)
+{
+    vector<int64_t> lookback;
+    for (const auto& in : op->inputs) {
+        if (!in->type.is_beat()) {
+            lookback.push_back(get_lookback(op, in));
+        }
+    }
+    return lookback;
+}
+
+size_t ParallelExecutor::MaxOutputs(const OpNode* op, ts_t dur)
+{
+    // Nested output operators run over one period at a time
+    size_t n = dur / op->iter.period + 1;
+    auto it = op->syms.find(op->output);
+    if (it != op->syms.end()) {
+        if (auto inner = dynamic_pointer_cast<OpNode>(it->second)) {
+            n *= MaxOutputs(inner.get(), op->iter.period);
+        }
+    }
+    return n;
+}
+
+bool ParallelExecutor::ReadsOutput(const OpNode* op)
+{
+    for (const auto& [_, expr] : op->syms) {
+        if (auto elem = dynamic_pointer_cast<Element>(expr)) {
+            if (elem->lstream->type.is_out()) { return true; }
+        } else if (auto subls = dynamic_pointer_cast<SubLStream>(expr)) {
+            if (subls->lstream->type.is_out()) { return true; }
+        }
+    }
+    return false;
+}
+
+region_t* ParallelExecutor::Run(ts_t st, ts_t et, region_t* out, vector<region_t*> ins)
+{
+    if (ins.size() != lookback.size()) {
+        throw std::runtime_error("Expected " + to_string(lookback.size()) + " input regions");
+    }
+    if (ins.empty() || ins.size() > 4) {
+        throw std::runtime_error("Loops with 1 to 4 inputs are supported");
+    }
+
+    auto period = op->iter.period;
+    auto len = chunk;
+    if (len == 0) {
+        len = max<ts_t>((et - st) / (threads * 4) / period, 1) * period;
+    }
+    if (ReadsOutput(op.get()) || et - st <= len) {
+        return call_loop(addr, st, et, out, ins.data(), ins.size());
+    }
+
+    size_t nchunks = (et - st + len - 1) / len;
+    vector<Chunk> chunks(nchunks);
+    atomic<size_t> next(0);
+    mutex mtx;
+    size_t stitched = 0;
+    exception_ptr error;
+
+    // Iterations of a loop end where its inputs change, or where the run
+    // ends. A chunk and a single run may thus end iterations at different
+    // times with different data, until both start one at the same time:
+    // the start of an output event, the end of one or the start of the
+    // chunk. Outputs are committed up to `pos`, where an iteration of the
+    // single run starts, and joined to the next chunk by a serial run from
+    // there until both are in step.
+    ts_t pos = st;
+    Chunk bridge;
+
+    // Inputs are visible from the earliest time a run from `t` reads
+    auto make_views = [&](ts_t t, vector<region_t>& views, vector<region_t*>& view_ptrs) {
+        for (size_t i = 0; i < ins.size(); i++) {
+            auto in = ins[i];
+            auto vst = max(t - lookback[i], get_start_time(in));
+            auto si = advance(in, get_start_idx(in), vst);
+            view_ptrs[i] = make_region(&views[i], in, vst, si, get_end_time(in), get_end_idx(in));
+        }
+    };
+
+    auto run = [&](Chunk& c, ts_t from, ts_t to, vector<region_t>& views, vector<region_t*>& view_ptrs) {
+        make_views(from, views, view_ptrs);
+        auto size = get_buf_size(MaxOutputs(op.get(), to - from));
+        c.tl.resize(size);
+        c.data.resize(static_cast<size_t>(size) * out_size);
+        init_region(&c.reg, from, size, c.tl.data(), c.data.data());
+        call_loop(addr, from, to, &c.reg, view_ptrs.data(), view_ptrs.size());
+    };
+
+    // Index of the first event of chunk `c` in step with the single run
+    // at `pos`, or -1
+    auto in_step = [&](const Chunk& c, ts_t cs) -> idx_t {
+        if (pos == cs) { return 0; }
+        for (idx_t i = 0; i <= c.reg.head && c.tl[i].t <= pos; i++) {
+            if (c.tl[i].t == pos) { return i; }
+            if (c.tl[i].t + c.tl[i].d == pos) { return i + 1; }
+        }
+        return -1;
+    };
+
+    // Commits the events of a run over [.., end) from `from` on. The last
+    // iteration of the run may be cut short at its end, so events from its
+    // start on are left for the next run. Nested output operators emit
+    // several events per iteration, which start iterations only where they
+    // lie on the period grid.
+    auto append = [&](const Chunk& c, idx_t from, ts_t end) {
+        auto n = c.reg.head + 1;
+        if (end < et) {
+            auto on_grid = [&](ts_t t) { return (t - st) % period == 0; };
+            auto last = pos;
+            for (auto i = n; i > from && last == pos; i--) {
+                auto ivl = c.tl[i - 1];
+                if (ivl.t + ivl.d < end && on_grid(ivl.t + ivl.d)) {
+                    last = ivl.t + ivl.d;
+                } else if (on_grid(ivl.t)) {
+                    last = ivl.t;
+                }
+            }
+            while (n > from && c.tl[n - 1].t + c.tl[n - 1].d > last) { n--; }
+            pos = last;
+        } else {
+            pos = et;
+        }
+        commit_batch(out, c.tl.data() + from, c.data.data() + static_cast<size_t>(from) * out_size, out_size,
+                     n - from);
+    };
+
+    auto stitch = [&](size_t k, vector<region_t>& views, vector<region_t*>& view_ptrs) {
+        auto& c = chunks[k];
+        auto cs = st + static_cast<ts_t>(k) * len;
+        auto ce = min(cs + len, et);
+
+        auto from = in_step(c, cs);
+        for (auto step = period; from < 0;) {
+            auto end = min(pos + step, ce);
+            run(bridge, pos, end, views, view_ptrs);
+            append(bridge, 0, end);
+            if (end == ce) { break; }
+            from = in_step(c, cs);
+            step *= 2;
+        }
+        if (from >= 0) {
+            append(c, from, ce);
+        }
+
+        vector<ival_t>().swap(c.tl);
+        vector<char>().swap(c.data);
+    };
+
+    auto worker = [&]() {
+        vector<region_t> views(ins.size());
+        vector<region_t*> view_ptrs(ins.size());
+        try {
+            for (auto k = next++; k < nchunks; k = next++) {
+                auto cs = st + static_cast<ts_t>(k) * len;
+                auto& c = chunks[k];
+                run(c, cs, min(cs + len, et), views, view_ptrs);
+
+                // Append the outputs of all chunks done in order
+                lock_guard<mutex> lock(mtx);
+                c.done = true;
+                while (stitched < nchunks && chunks[stitched].done) {
+                    stitch(stitched++, views, view_ptrs);
+                }
+            }
+        } catch (...) {
+            // Other workers stop after their current chunk
+            lock_guard<mutex> lock(mtx);
+            if (!error) { error = current_exception(); }
+            next = nchunks;
+        }
+    };
+
+    vector<thread> pool;
+    for (size_t i = 1; i < min<size_t>(threads, nchunks); i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : pool) {
+        t.join();
+    }
+    if (error) {
+        rethrow_exception(error);
+    }
+
+    return commit_null(out, et);
+}
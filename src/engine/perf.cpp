@@ -0,0 +1,37 @@
+#include <unistd.h>
+
+#include <ios>
+
+#include "llvm/Object/SymbolSize.h"
+
+#include "tilt/engine/perf.h"
+
+using namespace tilt;
+
+PerfMapListener::PerfMapListener() : out(Path(), ios::app) {}
+
+string PerfMapListener::Path() { return "/tmp/perf-" + to_string(getpid()) + ".map"; }
+
+void PerfMapListener::notifyObjectLoaded(ObjectKey key, const llvm::object::ObjectFile& obj,
+                                         const llvm::RuntimeDyld::LoadedObjectInfo& info)
+{
+    // The debug object has its sections relocated to their load addresses
+    auto debug_obj = info.getObjectForDebug(obj);
+    auto& loaded_obj = debug_obj.getBinary() ? *debug_obj.getBinary() : obj;
+
+    lock_guard<mutex> lock(mtx);
+    for (const auto& [sym, size] : llvm::object::computeSymbolSizes(loaded_obj)) {
+        auto type = sym.getType();
+        if (!type || *type != llvm::object::SymbolRef::ST_Function) { continue; }
+
+        auto name = sym.getName();
+        auto addr = sym.getAddress();
+        if (!name || !addr) {
+            llvm::consumeError(name.takeError());
+            llvm::consumeError(addr.takeError());
+            continue;
+        }
+        out << hex << *addr << " " << size << dec << " " << name->str() << "\n";
+    }
+    out.flush();
+}
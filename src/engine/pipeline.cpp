@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "tilt/engine/pipeline.h"
+#include "tilt/builder/tilder.h"
+#include "tilt/engine/parallel.h"
+#include "tilt/engine/concurrent.h"
+#include "tilt/engine/stream.h"
+#include "tilt/pass/codegen/vinstr.h"
+
+using namespace tilt;
+using namespace std::chrono;
+
+namespace {
+
+// Spins until `ready` returns true and returns the nanoseconds spent waiting
+template<typename F>
+int64_t wait_for(F ready)
+{
+    if (ready()) { return 0; }
+
+    auto start = steady_clock::now();
+    while (!ready()) {
+        std::this_thread::yield();
+    }
+    return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+}
+
+// Adds the symbols `expr` reads to `deps`, and those the symbols of `op`
+// read in turn, except for the symbols in `stop`
+void add_deps(const OpNode* op, const Expr& expr, const set<Sym>& stop, set<Sym>& deps)
+{
+    walk(expr, [&](const Expr& e) {
+        auto sym = dynamic_pointer_cast<Symbol>(e);
+        if (!sym || !deps.insert(sym).second || stop.count(sym)) { return; }
+        auto it = op->syms.find(sym);
+        if (it != op->syms.end()) {
+            add_deps(op, it->second, stop, deps);
+        }
+    });
+}
+
+}  // namespace
+
+PipelineExecutor::PipelineExecutor(vector<Stage> stages, ts_t chunk, size_t depth, RegionLayout layout) :
+    stages(stages), chunk(chunk), depth(depth), util(stages.size())
+{
+    check_default_layout(layout, "PipelineExecutor");
+    if (stages.empty() || depth == 0) {
+        throw std::runtime_error("Pipelines need at least one stage and one chunk between stages");
+    }
+    for (const auto& s : stages) {
+        auto lb = ParallelExecutor::Lookback(s.op.get());
+        if (lb.size() != 1) {
+            throw std::runtime_error("Pipeline stages must have a single input");
+        }
+        if (chunk <= 0 || chunk % s.op->iter.period != 0) {
+            throw std::runtime_error("Chunk must be a multiple of the period of every stage");
+        }
+        lookback.push_back(lb[0]);
+    }
+}
+
+region_t* PipelineExecutor::Run(ts_t st, ts_t et, region_t* out, region_t* in)
+{
+    auto n = stages.size();
+
+    // Link k holds the outputs of stage k that stage k + 1 has not
+    // released, up to `depth` chunks plus the events in its lookback
+    vector<unique_ptr<ConcurrentRegion>> links;
+    for (size_t k = 0; k + 1 < n; k++) {
+        auto op = stages[k].op.get();
+        auto capacity = depth * ParallelExecutor::MaxOutputs(op, chunk)
+            + ParallelExecutor::MaxOutputs(op, lookback[k + 1]) + 1;
+        links.push_back(make_unique<ConcurrentRegion>(stages[k].out_size, capacity, lookback[k + 1], st));
+    }
+
+    vector<int64_t> busy(n);
+    auto stage = [&](size_t k) {
+        auto start = steady_clock::now();
+        int64_t waited = 0;
+        auto& s = stages[k];
+
+        // Stages before the last write to a ring holding two chunks of
+        // outputs, which are then handed to the next stage
+        region_t ring;
+        vector<ival_t> ring_tl;
+        vector<char> ring_data;
+        auto dst = out;
+        if (k + 1 < n) {
+            auto size = get_buf_size(2 * ParallelExecutor::MaxOutputs(s.op.get(), chunk));
+            ring_tl.resize(size);
+            ring_data.resize(static_cast<size_t>(size) * s.out_size);
+            dst = init_region(&ring, st, size, ring_tl.data(), ring_data.data());
+        }
+        auto sent = get_end_idx(dst);
+
+        for (ts_t t = st; t < et;) {
+            auto ce = min(t + chunk, et);
+
+            region_t snap;
+            auto src = in;
+            if (k > 0) {
+                auto& link = *links[k - 1];
+                waited += wait_for([&]() { return link.Watermark() >= ce; });
+                src = link.Snapshot(&snap);
+            }
+            call_loop(s.addr, t, ce, dst, &src, 1);
+            if (k > 0) {
+                links[k - 1]->Release(ce);
+            }
+
+            if (k + 1 < n) {
+                // Outputs are contiguous up to the end of the ring
+                auto& link = *links[k];
+                auto head = get_end_idx(dst);
+                while (sent < head) {
+                    auto slot = (sent + 1) & dst->mask;
+                    auto m = min<idx_t>(head - sent, dst->mask + 1 - slot);
+                    auto tl = &dst->tl[slot];
+                    auto data = dst->data + static_cast<size_t>(slot) * s.out_size;
+                    waited += wait_for([&]() { return link.TryPush(tl, data, m); });
+                    sent += m;
+                }
+                waited += wait_for([&]() { return link.TryAdvance(ce); });
+            }
+            t = ce;
+        }
+
+        busy[k] = duration_cast<nanoseconds>(steady_clock::now() - start).count() - waited;
+    };
+
+    auto start = steady_clock::now();
+    vector<thread> threads;
+    for (size_t k = 1; k < n; k++) {
+        threads.emplace_back(stage, k);
+    }
+    stage(0);
+    for (auto& t : threads) {
+        t.join();
+    }
+    auto wall = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+
+    for (size_t k = 0; k < n; k++) {
+        util[k] = wall > 0 ? static_cast<double>(busy[k]) / wall : 0;
+    }
+    return out;
+}
+
+vector<Op> PipelineExecutor::Split(const Op op, const vector<Sym>& at)
+{
+    for (const auto& sym : at) {
+        auto it = op->syms.find(sym);
+        if (it == op->syms.end() || !dynamic_pointer_cast<OpNode>(it->second)) {
+            throw std::runtime_error("Stages are split at nested operators of the query");
+        }
+    }
+
+    vector<Op> stages;
+    set<Sym> stop;
+    for (size_t k = 0; k <= at.size(); k++) {
+        auto last = (k == at.size());
+        auto output = last ? op->output : at[k];
+        set<Sym> deps;
+        add_deps(op.get(), output, stop, deps);
+        if (last) {
+            add_deps(op.get(), op->pred, stop, deps);
+        }
+
+        SymTable syms;
+        Params inputs;
+        if (k > 0) {
+            auto prev = at[k - 1];
+            auto in = make_shared<Symbol>(prev->name + "_in", prev->type);
+            syms[prev] = make_shared<SubLStream>(in, tilder::_win(-op->iter.period, 0));
+            inputs.push_back(in);
+        }
+        for (const auto& in : op->inputs) {
+            if (deps.count(in)) { inputs.push_back(in); }
+        }
+        for (const auto& sym : deps) {
+            if (stop.count(sym)) {
+                if (sym != at[k - 1]) {
+                    throw std::runtime_error("Stage " + to_string(k) + " reads a stage other than the one before it");
+                }
+            } else if (op->syms.count(sym)) {
+                syms[sym] = op->syms.at(sym);
+            }
+        }
+
+        stages.push_back(make_shared<OpNode>(op->iter, inputs, syms, last ? op->pred : tilder::_true(), output,
+                                             last ? op->aux : Aux()));
+        if (!last) {
+            stop.insert(at[k]);
+        }
+    }
+    return stages;
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "tilt/engine/stream.h"
+#include "tilt/engine/ingest.h"
+#include "tilt/pass/codegen/vinstr.h"
+
+using namespace tilt;
+
+StreamDriver::StreamDriver(intptr_t addr, vector<uint32_t> in_sizes, uint32_t out_size, Sink sink,
+                           ts_t chunk, size_t in_capacity, size_t in_lookback, size_t out_capacity, ts_t start,
+                           RegionLayout layout) :
+    StreamDriver(addr, in_sizes, out_size,
+                 [sink, out_size](const ival_t* tl, const char* data, size_t n) {
+                     for (size_t i = 0; i < n; i++) {
+                         sink(tl[i], data + i * out_size);
+                     }
+                     return n;
+                 },
+                 chunk, in_capacity, in_lookback, out_capacity, start, layout)
+{}
+
+StreamDriver::StreamDriver(intptr_t addr, vector<uint32_t> in_sizes, uint32_t out_size, BatchSink sink,
+                           ts_t chunk, size_t in_capacity, size_t in_lookback, size_t out_capacity, ts_t start,
+                           RegionLayout layout) :
+    addr(addr), sink(sink), chunk(chunk), in_capacity(in_capacity), start(start), t(start), ins(in_sizes.size())
+{
+    check_default_layout(layout, "StreamDriver");
+    if (in_sizes.empty() || in_sizes.size() > 4) {
+        throw std::runtime_error("Streams support loops with 1 to 4 inputs");
+    }
+    if (chunk <= 0) {
+        throw std::runtime_error("Chunk must be positive");
+    }
+
+    // Pushes are bounded by the capacity, so they never overwrite the
+    // lookback behind the events of the last run
+    for (size_t i = 0; i < ins.size(); i++) {
+        init_buffer(ins[i], in_sizes[i], in_capacity + in_lookback);
+    }
+    // Bounded loops fill up to half of the output ring before they return
+    init_buffer(out, out_size, 2 * out_capacity);
+}
+
+void StreamDriver::init_buffer(Buffer& buf, uint32_t size, size_t capacity)
+{
+    auto buf_size = get_buf_size(capacity);
+    buf.size = size;
+    buf.tl.resize(buf_size);
+    buf.data.resize(static_cast<size_t>(buf_size) * size);
+    init_region(&buf.reg, t, buf_size, buf.tl.data(), buf.data.data());
+    buf.run_head = buf.reg.head;
+}
+
+void StreamDriver::Push(size_t i, ts_t st, ts_t et, const char* payload)
+{
+    auto& in = ins.at(i);
+    if (st < in.reg.et || et <= st) {
+        throw std::runtime_error("Events must be ordered and non-empty");
+    }
+    if (static_cast<size_t>(in.reg.head - in.run_head) >= in_capacity) {
+        throw std::runtime_error("Input " + to_string(i) + " is full");
+    }
+
+    if (st > in.reg.et) {
+        commit_null(&in.reg, st);
+    }
+    commit_data(&in.reg, et);
+    auto ptr = fetch(&in.reg, et, get_end_idx(&in.reg), in.size);
+    memcpy(ptr, payload, in.size);
+}
+
+void StreamDriver::Push(size_t i, const ival_t* tl, const char* data, size_t n)
+{
+    auto& in = ins.at(i);
+    auto et = in.reg.et;
+    for (size_t j = 0; j < n; j++) {
+        if (tl[j].t < et || tl[j].d == 0) {
+            throw std::runtime_error("Events must be ordered and non-empty");
+        }
+        et = tl[j].t + tl[j].d;
+    }
+    if (static_cast<size_t>(in.reg.head - in.run_head) + n > in_capacity) {
+        throw std::runtime_error("Input " + to_string(i) + " is full");
+    }
+
+    commit_batch(&in.reg, tl, data, in.size, n);
+}
+
+ts_t StreamDriver::Run()
+{
+    auto watermark = ins[0].reg.et;
+    for (const auto& in : ins) {
+        watermark = min(watermark, in.reg.et);
+    }
+
+    // Chunks are aligned to the start, also after a pause within a chunk
+    auto end = watermark - (watermark - start) % chunk;
+    if (end > t) {
+        run_until(end);
+    } else {
+        drain();
+    }
+    return t;
+}
+
+ts_t StreamDriver::Flush(ts_t end)
+{
+    for (auto& in : ins) {
+        if (in.reg.et < end) {
+            commit_null(&in.reg, end);
+        }
+    }
+
+    run_until(end);
+    return t;
+}
+
+void StreamDriver::run_until(ts_t end)
+{
+    while (t < end) {
+        // Events left in the ring by the sink could be overwritten
+        if (!drain()) { break; }
+
+        // Bounded loops stop early at the end time of their output
+        invoke(t, min(t + chunk - (t - start) % chunk, end));
+        t = out.reg.et;
+    }
+
+    // Only events ending by `t` are consumed, later ones are read again by
+    // the next run and must not count against the room for pushes
+    for (auto& in : ins) {
+        if (t >= in.reg.et) {
+            in.run_head = in.reg.head;
+        } else {
+            in.run_head = advance(&in.reg, in.run_head, t + 1) - 1;
+        }
+    }
+    drain();
+}
+
+void StreamDriver::invoke(ts_t st, ts_t et)
+{
+    region_t* regs[4];
+    for (size_t i = 0; i < ins.size(); i++) {
+        regs[i] = &ins[i].reg;
+    }
+    call_loop(addr, st, et, &out.reg, regs, ins.size());
+}
+
+bool StreamDriver::drain()
+{
+    auto head = get_end_idx(&out.reg);
+    while (out.run_head < head) {
+        // Pending events are contiguous up to the end of the ring
+        auto slot = (out.run_head + 1) & out.reg.mask;
+        auto n = min<idx_t>(head - out.run_head, out.reg.mask + 1 - slot);
+        auto done = sink(&out.reg.tl[slot], out.reg.data + static_cast<size_t>(slot) * out.size, n);
+        out.run_head += done;
+        if (static_cast<idx_t>(done) < n) { return false; }
+    }
+    return true;
+}
+
+namespace tilt {
+
+region_t* call_loop(intptr_t addr, ts_t st, ts_t et, region_t* out, region_t* const* ins, size_t n)
+{
+    switch (n) {
+        case 1: {
+            auto loop = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) addr;
+            return loop(st, et, out, ins[0]);
+        }
+        case 2: {
+            auto loop = (region_t* (*)(ts_t, ts_t, region_t*, region_t*, region_t*)) addr;
+            return loop(st, et, out, ins[0], ins[1]);
+        }
+        case 3: {
+            auto loop = (region_t* (*)(ts_t, ts_t, region_t*, region_t*, region_t*, region_t*)) addr;
+            return loop(st, et, out, ins[0], ins[1], ins[2]);
+        }
+        case 4: {
+            auto loop = (region_t* (*)(ts_t, ts_t, region_t*, region_t*, region_t*, region_t*, region_t*)) addr;
+            return loop(st, et, out, ins[0], ins[1], ins[2], ins[3]);
+        }
+        default: throw std::runtime_error("Loops with 1 to 4 inputs are supported");
+    }
+}
+
+}  // namespace tilt
@@ -36,3 +36,44 @@ void CommitNull::Accept(Visitor& v) const { v.Visit(*this); }
 void AllocRegion::Accept(Visitor& v) const { v.Visit(*this); }
 void MakeRegion::Accept(Visitor& v) const { v.Visit(*this); }
 void LoopNode::Accept(Visitor& v) const { v.Visit(*this); }
+
+void tilt::walk(const Expr& expr, const function<void(const Expr&)>& fn)
+{
+    fn(expr);
+    if (auto e = dynamic_pointer_cast<Cast>(expr)) {
+        walk(e->arg, fn);
+    } else if (auto e = dynamic_pointer_cast<NaryExpr>(expr)) {
+        for (const auto& arg : e->args) { walk(arg, fn); }
+    } else if (auto e = dynamic_pointer_cast<Get>(expr)) {
+        walk(e->input, fn);
+    } else if (auto e = dynamic_pointer_cast<New>(expr)) {
+        for (const auto& input : e->inputs) { walk(input, fn); }
+    } else if (auto e = dynamic_pointer_cast<Select>(expr)) {
+        walk(e->cond, fn);
+        walk(e->true_body, fn);
+        walk(e->false_body, fn);
+    } else if (auto e = dynamic_pointer_cast<IfElse>(expr)) {
+        walk(e->cond, fn);
+        walk(e->true_body, fn);
+        walk(e->false_body, fn);
+    } else if (auto e = dynamic_pointer_cast<Call>(expr)) {
+        for (const auto& arg : e->args) { walk(arg, fn); }
+    } else if (auto e = dynamic_pointer_cast<Exists>(expr)) {
+        walk(e->sym, fn);
+    } else if (auto e = dynamic_pointer_cast<Element>(expr)) {
+        walk(e->lstream, fn);
+    } else if (auto e = dynamic_pointer_cast<SubLStream>(expr)) {
+        walk(e->lstream, fn);
+    } else if (auto e = dynamic_pointer_cast<OpNode>(expr)) {
+        for (const auto& input : e->inputs) { walk(input, fn); }
+    } else if (auto e = dynamic_pointer_cast<Reduce>(expr)) {
+        walk(e->lstream, fn);
+        walk(e->state, fn);
+        for (const auto& arg : e->args) { walk(arg, fn); }
+        auto st = make_shared<Symbol>("st", Type(types::TIME));
+        auto et = make_shared<Symbol>("et", Type(types::TIME));
+        auto data = make_shared<Symbol>("data", Type(e->lstream->type.dtype));
+        walk(e->acc(e->state, st, et, data), fn);
+        if (e->evict) { walk(e->evict(e->state, st, et, data), fn); }
+    }
+}
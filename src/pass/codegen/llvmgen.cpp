@@ -1,5 +1,6 @@
 #include "tilt/base/type.h"
 #include "tilt/pass/codegen/llvmgen.h"
+#include "tilt/pass/codegen/vinstr.h"
 
 #include "llvm/IR/Function.h"
 #include "llvm/IR/DataLayout.h"
@@ -36,6 +37,15 @@ Value* LLVMGen::llcall(const string name, llvm::Type* ret_type, vector<Expr> arg
     return llcall(name, ret_type, arg_vals);
 }
 
+llvm::Type* LLVMGen::lltltype()
+{
+    if (layout.compact) {
+        auto u32_type = lltype(types::UINT32);
+        return StructType::get(llctx(), { u32_type, u32_type });
+    }
+    return lltype(types::IVAL);
+}
+
 Value* LLVMGen::llsizeof(llvm::Type* type)
 {
     auto size = llmod()->getDataLayout().getTypeSizeInBits(type).getFixedSize();
@@ -141,6 +151,12 @@ Value* LLVMGen::visit(const Select& select)
 
 Value* LLVMGen::visit(const Get& get)
 {
+    // Fields read from columnar regions are loaded from their column alone
+    if (auto read = col_read(get.input)) {
+        auto fetch = col_fetch(read->ptr);
+        return builder()->CreateLoad(lltype(get), llcolptr(*fetch, get.n));
+    }
+
     auto input = eval(get.input);
     return builder()->CreateExtractValue(input, get.n);
 }
@@ -346,19 +362,25 @@ Value* LLVMGen::visit(const Fetch& fetch)
     auto idx_val = eval(fetch.idx);
     auto size_val = llsizeof(lltype(dtype));
     auto ret_type = lltype(types::CHAR_PTR);
-    auto addr = llcall("fetch", ret_type, { reg_val, time_val, idx_val, size_val });
+
+    Value* addr = nullptr;
+    if (fetch.reg->type.is_regular()) {
+        addr = llcall("fetch_regular", ret_type, { reg_val, time_val, idx_val, size_val });
+    } else {
+        addr = llcall(tlvinstr("fetch"), ret_type, { reg_val, time_val, idx_val, size_val });
+    }
 
     return builder()->CreateBitCast(addr, lltype(fetch));
 }
 
 Value* LLVMGen::visit(const Advance& adv)
 {
-    return llcall("advance", lltype(adv), { adv.reg, adv.idx, adv.time });
+    return llcall(tlvinstr("advance"), lltype(adv), { adv.reg, adv.idx, adv.time });
 }
 
 Value* LLVMGen::visit(const GetCkpt& next)
 {
-    return llcall("get_ckpt", lltype(next), { next.reg, next.time, next.idx });
+    return llcall(tlvinstr("get_ckpt"), lltype(next), { next.reg, next.time, next.idx });
 }
 
 Value* LLVMGen::visit(const GetStartIdx& start_idx)
@@ -383,16 +405,26 @@ Value* LLVMGen::visit(const GetEndTime& end_time)
 
 Value* LLVMGen::visit(const CommitNull& commit)
 {
-    return llcall("commit_null", lltype(commit), { commit.reg, commit.time });
+    return llcall(tlvinstr("commit_null"), lltype(commit), { commit.reg, commit.time });
 }
 
 Value* LLVMGen::visit(const CommitData& commit)
 {
-    return llcall("commit_data", lltype(commit), { commit.reg, commit.time });
+    return llcall(tlvinstr("commit_data"), lltype(commit), { commit.reg, commit.time });
 }
 
 Value* LLVMGen::visit(const Read& read)
 {
+    if (auto fetch = col_fetch(read.ptr)) {
+        auto struct_type = lltype(read);
+        Value* val = UndefValue::get(struct_type);
+        for (size_t i = 0; i < read.type.dtype.dtypes.size(); i++) {
+            auto field_val = builder()->CreateLoad(struct_type->getStructElementType(i), llcolptr(*fetch, i));
+            val = builder()->CreateInsertValue(val, field_val, i);
+        }
+        return val;
+    }
+
     auto ptr_val = eval(read.ptr);
     auto ptr_type = read.ptr->type.dtype;
     return builder()->CreateLoad(lltype(ptr_type.deref()), ptr_val);
@@ -401,22 +433,91 @@ Value* LLVMGen::visit(const Read& read)
 Value* LLVMGen::visit(const Write& write)
 {
     auto reg_val = eval(write.reg);
+    if (auto fetch = col_fetch(write.ptr)) {
+        auto data_val = eval(write.data);
+        for (size_t i = 0; i < write.data->type.dtype.dtypes.size(); i++) {
+            auto field_val = builder()->CreateExtractValue(data_val, i);
+            builder()->CreateStore(field_val, llcolptr(*fetch, i));
+        }
+        return reg_val;
+    }
+
     auto ptr_val = eval(write.ptr);
     auto data_val = eval(write.data);
     builder()->CreateStore(data_val, ptr_val);
     return reg_val;
 }
 
+const Fetch* LLVMGen::col_fetch(const Expr& ptr)
+{
+    if (!layout.columnar) { return nullptr; }
+
+    auto expr = ptr;
+    if (auto sym = dynamic_pointer_cast<Symbol>(ptr)) {
+        auto it = ctx().loop->syms.find(sym);
+        if (it == ctx().loop->syms.end()) { return nullptr; }
+        expr = it->second;
+    }
+    auto fetch = dynamic_cast<const Fetch*>(expr.get());
+    return (fetch && fetch->reg->type.dtype.is_struct()) ? fetch : nullptr;
+}
+
+const Read* LLVMGen::col_read(const Expr& val)
+{
+    auto expr = val;
+    if (auto sym = dynamic_pointer_cast<Symbol>(val)) {
+        auto it = ctx().loop->syms.find(sym);
+        if (it == ctx().loop->syms.end()) { return nullptr; }
+        expr = it->second;
+    }
+    auto read = dynamic_cast<const Read*>(expr.get());
+    return (read && col_fetch(read->ptr)) ? read : nullptr;
+}
+
+Value* LLVMGen::llcolptr(const Fetch& fetch, size_t i)
+{
+    auto struct_type = cast<StructType>(lltype(fetch.reg->type.dtype));
+    auto field_type = struct_type->getElementType(i);
+    auto& dl = llmod()->getDataLayout();
+    auto off_val = builder()->getInt32(dl.getStructLayout(struct_type)->getElementOffset(i));
+    auto size_val = builder()->getInt32(dl.getTypeAllocSize(field_type));
+    auto addr = llcall("fetch_col", lltype(types::CHAR_PTR), { eval(fetch.reg), eval(fetch.idx), off_val, size_val });
+    return builder()->CreateBitCast(addr, PointerType::get(field_type, 0));
+}
+
 Value* LLVMGen::visit(const AllocRegion& alloc)
 {
     auto time_val = eval(alloc.start_time);
-    auto size_val = llcall("get_buf_size", lltype(types::UINT32), { eval(alloc.size) });
-    auto tl_arr = builder()->CreateAlloca(lltype(types::IVAL), size_val);
-    auto data_arr = builder()->CreateAlloca(lltype(alloc.type.dtype), size_val);
+    auto len_val = eval(alloc.size);
+    auto tl_type = lltltype();
+    auto data_type = lltype(alloc.type.dtype);
+
+    auto& dl = llmod()->getDataLayout();
+    auto ev_bytes = dl.getTypeAllocSize(tl_type) + dl.getTypeAllocSize(data_type);
+    auto const_len = dyn_cast<ConstantInt>(len_val);
+
+    Value* size_val;
+    Value* tl_arr;
+    Value* data_arr;
+    if (const_len && get_buf_size(const_len->getSExtValue()) * ev_bytes <= MAX_STACK_REGION_SIZE) {
+        // Small regions of static size stay on the stack
+        size_val = builder()->getInt32(get_buf_size(const_len->getSExtValue()));
+        tl_arr = builder()->CreateAlloca(tl_type, size_val);
+        data_arr = builder()->CreateAlloca(data_type, size_val);
+    } else {
+        // Regions of unbounded size would overflow the stack, so they borrow
+        // a buffer from the pool and return it with the same scope
+        size_val = llcall("get_buf_size", lltype(types::UINT32), { len_val });
+        auto ev_bytes_val = builder()->getInt32(ev_bytes.getFixedSize());
+        auto buf = llcall("pool_borrow", lltype(types::CHAR_PTR), { size_val, ev_bytes_val });
+        tl_arr = builder()->CreateBitCast(buf, PointerType::get(tl_type, 0));
+        data_arr = builder()->CreateGEP(tl_type, tl_arr, size_val);
+        ctx().uses_pool = true;
+    }
     auto char_arr = builder()->CreateBitCast(data_arr, lltype(types::CHAR_PTR));
 
     auto reg_val = builder()->CreateAlloca(llregtype());
-    return llcall("init_region", lltype(alloc), { reg_val, time_val, size_val, tl_arr, char_arr });
+    return llcall(tlvinstr("init_region"), lltype(alloc), { reg_val, time_val, size_val, tl_arr, char_arr });
 }
 
 Value* LLVMGen::visit(const MakeRegion& make_reg)
@@ -504,6 +605,14 @@ Value* LLVMGen::visit(const LoopNode& loop)
     // Update loop counter
     eval(loop.t);
 
+    // Update the other loop states before the output, which may only read
+    // them on one of its branches
+    for (const auto& [var, _] : loop.state_bases) {
+        if (var != loop.output) {
+            eval(var);
+        }
+    }
+
     // Evaluate loop output
     eval(loop.output);
     for (const auto& [var, base] : loop.state_bases) {
@@ -523,22 +632,58 @@ Value* LLVMGen::visit(const LoopNode& loop)
     builder()->SetInsertPoint(exit_bb);
     builder()->CreateRet(eval(loop.state_bases.at(loop.output)));
 
+    // Return pooled buffers on exit and at the end of every iteration
+    if (ctx().uses_pool) {
+        builder()->SetInsertPoint(preheader_bb, preheader_bb->getFirstInsertionPt());
+        auto fn_mark = llcall("pool_mark", lltype(types::UINT64), vector<Value*>{});
+        builder()->SetInsertPoint(exit_bb->getTerminator());
+        llcall("pool_release", llvm::Type::getVoidTy(llctx()), { fn_mark });
+
+        builder()->SetInsertPoint(stack_val->getNextNode());
+        auto iter_mark = llcall("pool_mark", lltype(types::UINT64), vector<Value*>{});
+        builder()->SetInsertPoint(end_bb->getTerminator());
+        llcall("pool_release", llvm::Type::getVoidTy(llctx()), { iter_mark });
+    }
+
     return loop_fn;
 }
 
-unique_ptr<llvm::Module> LLVMGen::Build(const Loop loop, llvm::LLVMContext& llctx)
+unique_ptr<llvm::Module> LLVMGen::Build(const Loop loop, llvm::LLVMContext& llctx, RegionLayout layout)
 {
     LLVMGenCtx ctx(loop.get(), &llctx);
-    LLVMGen llgen(std::move(ctx));
+    LLVMGen llgen(std::move(ctx), layout);
     loop->Accept(llgen);
+    llgen.register_vinstrs();
     return std::move(llgen._llmod);
 }
 
-void LLVMGen::register_vinstrs() {
-    const auto buffer = llvm::MemoryBuffer::getMemBuffer(llvm::StringRef(vinstr_str));
+const llvm::Module& LLVMGen::vinstr_module(llvm::LLVMContext& llctx)
+{
+    // Parsed vinstr modules are kept per context as templates for linking.
+    // The context owns the template and releases it on destruction.
+    // A freed context's address can be reused by a new one, so each
+    // template is tagged with a metadata kind registered in its context.
+    static mutex vinstr_mtx;
+    static map<llvm::LLVMContext*, pair<llvm::Module*, string>> vinstr_mods;
+    static uint64_t vinstr_serial = 0;
+
+    lock_guard<mutex> lock(vinstr_mtx);
+    auto it = vinstr_mods.find(&llctx);
+    if (it != vinstr_mods.end()) {
+        SmallVector<StringRef, 64> kinds;
+        llctx.getMDKindNames(kinds);
+        if (find(kinds.begin(), kinds.end(), it->second.second) != kinds.end()) {
+            return *it->second.first;
+        }
+        // The context was freed along with the template
+        vinstr_mods.erase(it);
+    }
+
+    auto vinstr_data = llvm::StringRef(reinterpret_cast<const char*>(vinstr_bc), vinstr_bc_len);
+    llvm::MemoryBufferRef buffer(vinstr_data, "vinstr");
 
     llvm::SMDiagnostic error;
-    std::unique_ptr<llvm::Module> vinstr_mod = llvm::parseIR(*buffer, error, llctx());
+    std::unique_ptr<llvm::Module> vinstr_mod = llvm::parseIR(buffer, error, llctx);
     if (!vinstr_mod) {
         throw std::runtime_error("Failed to parse vinstr bitcode");
     }
@@ -546,20 +691,33 @@ void LLVMGen::register_vinstrs() {
         throw std::runtime_error("Failed to verify vinstr module");
     }
 
+    auto tag = "tilt.vinstr." + to_string(vinstr_serial++);
+    llctx.getMDKindID(tag);
+    auto vinstr_ptr = vinstr_mod.release();
+    vinstr_mods[&llctx] = { vinstr_ptr, tag };
+    return *vinstr_ptr;
+}
+
+void LLVMGen::register_vinstrs() {
     // For some reason if we try to set internal linkage before we link
     // modules, then the JIT will be unable to find the symbols.
     // Instead we collect the function names first, then add internal
     // linkage to them after linking the modules
     std::vector<string> vinstr_names;
-    for (const auto& function : vinstr_mod->functions()) {
+    for (const auto& function : _vinstr_mod.functions()) {
         if (function.isDeclaration()) {
             continue;
         }
         vinstr_names.push_back(function.getName().str());
     }
 
-    llvm::Linker::linkModules(*llmod(), std::move(vinstr_mod));
+    // Only the vinstrs referenced by the generated loops are linked
+    auto vinstr_mod = llvm::CloneModule(_vinstr_mod);
+    llvm::Linker::linkModules(*llmod(), std::move(vinstr_mod), llvm::Linker::Flags::LinkOnlyNeeded);
     for (const auto& name : vinstr_names) {
-        llmod()->getFunction(name.c_str())->setLinkage(llvm::Function::InternalLinkage);
+        auto fn = llmod()->getFunction(name);
+        if (fn && !fn->isDeclaration()) {
+            fn->setLinkage(llvm::Function::InternalLinkage);
+        }
     }
 }
@@ -1,3 +1,4 @@
+#include <limits>
 #include <string>
 #include <unordered_set>
 
@@ -32,6 +33,23 @@ Expr get_beat_time(Sym reg, Expr idx)
     return _mul(_cast(types::TIME, idx), period);
 }
 
+// Event `i` of a regular stream spans (offset + i * period, offset + (i + 1) * period]
+Expr get_regular_idx(Sym reg, Expr time)
+{
+    auto period = _ts(reg->type.iter.period);
+    auto offset = _ts(reg->type.iter.offset + 1);
+    auto start_idx = _cast(types::TIME, _get_start_idx(reg));
+    auto end_idx = _cast(types::TIME, _get_end_idx(reg));
+    return _cast(types::INDEX, _min(end_idx, _max(start_idx, _div(_sub(time, offset), period))));
+}
+
+Expr get_regular_time(Sym reg, Expr idx)
+{
+    auto period = _ts(reg->type.iter.period);
+    auto offset = _ts(reg->type.iter.offset);
+    return _add(offset, _mul(_cast(types::TIME, _add(idx, _idx(1))), period));
+}
+
 Index& LoopGen::get_idx(const Sym reg, const Point pt)
 {
     auto& pt_idx_map = ctx().pt_idx_maps[reg];
@@ -46,6 +64,11 @@ Index& LoopGen::get_idx(const Sym reg, const Point pt)
 
             // Index shift expression
             next_ckpt = get_beat_time(reg, idx);
+        } else if (reg->type.is_regular()) {
+            // Regular streams have no timeline to advance over. Past the
+            // end of the region the index stays at the last event.
+            set_expr(idx, get_regular_idx(reg, time));
+            next_ckpt = _max(time, get_regular_time(reg, idx));
         } else {
             auto idx_base = _index("i" + to_string(pt.offset) + "_" + reg->name + "_base");
 
@@ -106,6 +129,23 @@ void LoopGen::build_tloop(function<Expr()> true_body, function<Expr()> false_bod
     loop->output = _sym("output", ctx().loop->type);
     loop->state_bases[loop->output] = output_base;
 
+    // Bounded loops also exit at the high-water mark of the output. The
+    // mark moves with the head, so it is taken once on entry: only state
+    // bases are evaluated before the loop, and the limit is a state that
+    // keeps its initial value. Like `t_base`, the exit condition reads the
+    // base, which holds the current value of the state.
+    if (bounded) {
+        auto out_limit_base = _index("out_limit_base");
+        set_expr(out_limit_base, _call("get_high_water", Type(types::INDEX), vector<Expr>{ out_arg }));
+        auto out_limit = _index("out_limit");
+        loop->state_bases[out_limit] = out_limit_base;
+        set_expr(out_limit, out_limit_base);
+
+        // Compare as signed, since the head of an empty region is -1
+        auto out_head = _cast(types::TIME, _get_end_idx(output_base));
+        loop->exit_cond = _or(loop->exit_cond, _gte(out_head, _cast(types::TIME, out_limit_base)));
+    }
+
     // Evaluate loop body
     auto pred_expr = eval(ctx().op->pred);
     eval(ctx().op->output);
@@ -322,21 +362,25 @@ Expr LoopGen::visit(const OpNode& op)
     return _call(inner_loop->get_name(), inner_loop->type, std::move(args));
 }
 
-Expr LoopGen::visit(const Reduce& red)
+Loop LoopGen::build_red_loop(const Reduce& red, Sym sym, AccTy acc)
 {
     auto e = _elem(red.lstream, _pt(0));
     auto e_sym = _sym("e", e);
+
+    // Values read by the accumulate function are passed to the loop
+    Params inputs{red.lstream};
+    inputs.insert(inputs.end(), red.args.begin(), red.args.end());
     auto red_op = _op(
         _iter(0, 1),
-        Params{red.lstream},
+        inputs,
         SymTable{
             {e_sym, e}
         },
         _exists(e_sym),
         e_sym);
 
-    auto red_loop = _loop(ctx().sym);
-    LoopGenCtx new_ctx(ctx().sym, red_op.get(), red_loop);
+    auto red_loop = _loop(sym);
+    LoopGenCtx new_ctx(sym, red_op.get(), red_loop);
 
     auto& old_ctx = switch_ctx(new_ctx);
 
@@ -346,7 +390,7 @@ Expr LoopGen::visit(const Reduce& red)
         auto t = loop->t;
         auto t_base = loop->state_bases[t];
         auto out_sym = get_sym(ctx().op->output);
-        return eval(red.acc(output_base, t_base, t, out_sym));
+        return eval(acc(output_base, t_base, t, out_sym));
     };
 
     auto false_body = [&]() -> Expr {
@@ -357,21 +401,105 @@ Expr LoopGen::visit(const Reduce& red)
     build_tloop(true_body, false_body);
     switch_ctx(old_ctx);
 
-    auto outer_loop = ctx().loop;
-    outer_loop->inner_loops.push_back(red_loop);
+    ctx().loop->inner_loops.push_back(red_loop);
+    return red_loop;
+}
 
+// The state of the reduction is kept across iterations of the enclosing
+// loop. Every iteration accumulates the events starting between the previous
+// and the current end of the window and evicts the events ending between the
+// previous and the current start, so each event is visited twice rather than
+// once per window it falls into. An event is thus in the state exactly while
+// it overlaps the window, as when the window is reduced as a whole, however
+// many iterations it spans. The times passed to the functions are those of
+// the part of the event between the bounds of the update.
+Expr LoopGen::build_incr_red(const Reduce& red, const SubLStream& win)
+{
+    auto loop = ctx().loop;
+    auto name = ctx().sym->name;
+    auto acc_loop = build_red_loop(red, ctx().sym, red.acc);
+    auto evict_loop = build_red_loop(red, _sym(name + "_evict", ctx().sym->type), red.evict);
+
+    eval(win.lstream);
+    auto reg = get_sym(win.lstream);
+    auto& si = get_idx(reg, win.win.start);
+    auto& ei = get_idx(reg, win.win.end);
+    auto start = _ts(win.win.start.offset);
+    auto end = _ts(win.win.end.offset);
+
+    // The state starts as the reduction over the window at the start of the loop
+    auto t_start = loop->inputs[0];
+    auto init_st = _add(t_start, start);
+    auto init_et = _add(t_start, end);
+    auto init_reg = _make_reg(reg, init_st, _adv(reg, _get_start_idx(reg), init_st),
+        init_et, _adv(reg, _get_start_idx(reg), init_et));
+    auto state_base = _sym(name + "_base", red.type);
+    set_expr(state_base, _call(acc_loop->get_name(), acc_loop->type,
+        vector<Expr>{ init_st, init_et, eval(red.state), init_reg }));
+
+    // Events entering and leaving the window since the last iteration. The
+    // previous end index is at the first event ending at or after the
+    // previous end of the window, which has entered already if it starts
+    // before it. The current start index is at the first event ending at or
+    // after the start of the window, which stays unless it ends there.
+    auto t_base = loop->state_bases[loop->t];
+    auto prev_et = _add(t_base, end);
+    auto cur_et = get_timer(win.win.end);
+    auto enter_st = _max(prev_et, _min(cur_et, _get_ckpt(reg, prev_et, loop->state_bases[ei])));
+    auto enter = _make_reg(reg, enter_st, loop->state_bases[ei], cur_et, ei);
+    auto enter_sym = _sym(name + "_enter", enter);
+    set_expr(enter_sym, enter);
+    auto prev_st = _add(t_base, start);
+    auto cur_st = get_timer(win.win.start);
+    auto first_st = _get_ckpt(reg, _ts(numeric_limits<ts_t>::min()), si);
+    auto leave_et = _sel(_gt(_get_ckpt(reg, cur_st, si), cur_st), _max(prev_st, _min(cur_st, first_st)), cur_st);
+    auto leave = _make_reg(reg, prev_st, loop->state_bases[si], leave_et, si);
+    auto leave_sym = _sym(name + "_leave", leave);
+    set_expr(leave_sym, leave);
+
+    auto added = _call(acc_loop->get_name(), acc_loop->type,
+        vector<Expr>{ _get_start_time(enter_sym), _get_end_time(enter_sym), state_base, enter_sym });
+    auto added_sym = _sym(name + "_added", added);
+    set_expr(added_sym, added);
+    auto state = _sym(name + "_state", red.type);
+    set_expr(state, _call(evict_loop->get_name(), evict_loop->type,
+        vector<Expr>{ _get_start_time(leave_sym), _get_end_time(leave_sym), added_sym, leave_sym }));
+    loop->state_bases[state] = state_base;
+
+    return state;
+}
+
+Expr LoopGen::visit(const Reduce& red)
+{
+    // Reductions over windows longer than the period that can evict events
+    // are updated incrementally. Beats and regular streams have no timeline
+    // to take the events from, and windows over the output are not covered.
+    auto it = ctx().op->syms.find(red.lstream);
+    auto win = (it != ctx().op->syms.end()) ? dynamic_pointer_cast<SubLStream>(it->second) : nullptr;
+    if (red.evict && red.args.empty() && win) {
+        const auto& in_type = win->lstream->type;
+        auto len = win->win.end.offset - win->win.start.offset;
+        if (!in_type.is_beat() && !in_type.is_regular() && !in_type.is_out() && len > ctx().op->iter.period) {
+            return build_incr_red(red, *win);
+        }
+    }
+
+    auto red_loop = build_red_loop(red, ctx().sym, red.acc);
     auto red_input = eval(red.lstream);
     auto t_start = _get_start_time(red_input);
     auto t_end = _get_end_time(red_input);
     vector<Expr> args = { t_start, t_end, eval(red.state), red_input };
+    for (const auto& arg : red.args) {
+        args.push_back(eval(arg));
+    }
     return _call(red_loop->get_name(), red_loop->type, args);
 }
 
-Loop LoopGen::Build(Sym sym, const OpNode* op)
+Loop LoopGen::Build(Sym sym, const OpNode* op, bool bounded)
 {
     auto loop = _loop(sym);
     LoopGenCtx ctx(sym, op, loop);
-    LoopGen loopgen(std::move(ctx));
+    LoopGen loopgen(std::move(ctx), bounded);
     loopgen.build_loop();
     return loopgen.ctx().loop;
 }
@@ -0,0 +1,91 @@
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tilt/pass/codegen/pool.h"
+
+using namespace std;
+
+namespace {
+
+atomic<uint64_t> allocs(0);
+atomic<uint64_t> frees(0);
+atomic<uint64_t> borrows(0);
+atomic<uint64_t> returns(0);
+atomic<uint64_t> bytes(0);
+
+uint64_t buf_bytes(uint32_t size, uint32_t ev_bytes)
+{
+    return static_cast<uint64_t>(size) * ev_bytes;
+}
+
+struct Pool {
+    // Key holds the capacity in the upper and the event size in the lower half
+    unordered_map<uint64_t, vector<char*>> free_bufs;
+    vector<pair<uint64_t, char*>> borrowed;
+
+    ~Pool()
+    {
+        for (const auto& [key, bufs] : free_bufs) {
+            for (auto buf : bufs) {
+                ::operator delete(buf);
+                frees.fetch_add(1, memory_order_relaxed);
+                bytes.fetch_sub(buf_bytes(key >> 32, key & 0xffffffff), memory_order_relaxed);
+            }
+        }
+    }
+};
+
+thread_local Pool pool;
+
+}  // namespace
+
+namespace tilt {
+extern "C" {
+
+char* pool_borrow(uint32_t size, uint32_t ev_bytes)
+{
+    auto key = (static_cast<uint64_t>(size) << 32) | ev_bytes;
+    auto& bufs = pool.free_bufs[key];
+
+    char* buf;
+    if (bufs.empty()) {
+        auto len = buf_bytes(size, ev_bytes);
+        buf = static_cast<char*>(::operator new(len));
+        allocs.fetch_add(1, memory_order_relaxed);
+        bytes.fetch_add(len, memory_order_relaxed);
+    } else {
+        buf = bufs.back();
+        bufs.pop_back();
+    }
+    borrows.fetch_add(1, memory_order_relaxed);
+
+    pool.borrowed.emplace_back(key, buf);
+    return buf;
+}
+
+uint64_t pool_mark() { return pool.borrowed.size(); }
+
+void pool_release(uint64_t mark)
+{
+    while (pool.borrowed.size() > mark) {
+        auto [key, buf] = pool.borrowed.back();
+        pool.borrowed.pop_back();
+        pool.free_bufs[key].push_back(buf);
+        returns.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void pool_stats(pool_stats_t* stats)
+{
+    stats->allocs = allocs.load(memory_order_relaxed);
+    stats->frees = frees.load(memory_order_relaxed);
+    stats->borrows = borrows.load(memory_order_relaxed);
+    stats->returns = returns.load(memory_order_relaxed);
+    stats->bytes = bytes.load(memory_order_relaxed);
+}
+
+}  // extern "C"
+}  // namespace tilt
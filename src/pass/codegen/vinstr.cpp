@@ -1,5 +1,87 @@
 #include "tilt/pass/codegen/vinstr.h"
 
+namespace {
+
+// Timestamps of compact timelines keep their low 32 bits. The events of a
+// region lie within 2^31 time units of its end, which restores the rest.
+inline ts_t get_time(const region_t* reg, const ival_t& ivl) { return ivl.t; }
+
+inline ts_t get_time(const region_t* reg, const cival_t& ivl)
+{
+    return reg->et + static_cast<int32_t>(ivl.t - static_cast<uint32_t>(reg->et));
+}
+
+inline void set_ivl(region_t* reg, idx_t i, ts_t t, dur_t d) { reg->tl[i & reg->mask] = { t, d }; }
+
+inline void set_civl(region_t* reg, idx_t i, ts_t t, dur_t d)
+{
+    reinterpret_cast<cival_t*>(reg->tl)[i & reg->mask] = { static_cast<uint32_t>(t), d };
+}
+
+template<typename IvalTy>
+inline const IvalTy& get_ivl(const region_t* reg, idx_t i)
+{
+    return reinterpret_cast<const IvalTy*>(reg->tl)[i & reg->mask];
+}
+
+template<typename IvalTy>
+inline ts_t get_ivl_end(const region_t* reg, idx_t i)
+{
+    const auto& ivl = get_ivl<IvalTy>(reg, i);
+    return get_time(reg, ivl) + ivl.d;
+}
+
+template<typename IvalTy>
+inline ts_t get_ckpt_tl(const region_t* reg, ts_t t, idx_t i)
+{
+    const auto& ivl = get_ivl<IvalTy>(reg, i);
+    auto st = get_time(reg, ivl);
+    return (t <= st) ? st : (st + ivl.d);
+}
+
+template<typename IvalTy>
+inline idx_t advance_tl(const region_t* reg, idx_t i, ts_t t)
+{
+    // Dense inputs move by a few events per step, which a scan handles best
+    for (int n = 0; n < 16; n++, i++) {
+        if (get_ivl_end<IvalTy>(reg, i) >= t) { return i; }
+    }
+
+    // Beyond the last event the search has no upper bound, so keep scanning
+    auto hi = reg->head;
+    if (i >= hi || get_ivl_end<IvalTy>(reg, hi) < t) {
+        while (get_ivl_end<IvalTy>(reg, i) < t) { i++; }
+        return i;
+    }
+
+    // Sparse inputs: gallop to bracket the event ending at or after `t`,
+    // then binary search. Indices stay logical until they are masked.
+    auto lo = i - 1;
+    idx_t step = 1;
+    while (lo + step < hi && get_ivl_end<IvalTy>(reg, lo + step) < t) {
+        lo += step;
+        step <<= 1;
+    }
+    hi = (lo + step < hi) ? lo + step : hi;
+    while (hi - lo > 1) {
+        auto mid = lo + (hi - lo) / 2;
+        if (get_ivl_end<IvalTy>(reg, mid) < t) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return hi;
+}
+
+template<typename IvalTy>
+inline char* fetch_tl(const region_t* reg, ts_t t, idx_t i, uint32_t bytes)
+{
+    return (t <= get_time(reg, get_ivl<IvalTy>(reg, i))) ? nullptr : (reg->data + ((i & reg->mask) * bytes));
+}
+
+}  // namespace
+
 namespace tilt {
 extern "C" {
 
@@ -19,26 +101,38 @@ idx_t get_start_idx(region_t* reg)
 
 idx_t get_end_idx(region_t* reg) { return reg->head; }
 
+idx_t get_high_water(region_t* reg) { return reg->head + (reg->mask + 1) / 2; }
+
 ts_t get_start_time(region_t* reg) { return reg->st; }
 
 ts_t get_end_time(region_t* reg) { return reg->et; }
 
-int64_t get_ckpt(region_t* reg, ts_t t, idx_t i)
-{
-    auto civl = reg->tl[i & reg->mask];
-    return (t <= civl.t) ? civl.t : (civl.t + civl.d);
-}
+int64_t get_ckpt(region_t* reg, ts_t t, idx_t i) { return get_ckpt_tl<ival_t>(reg, t, i); }
 
-idx_t advance(region_t* reg, idx_t i, ts_t t)
+int64_t get_ckpt_compact(region_t* reg, ts_t t, idx_t i) { return get_ckpt_tl<cival_t>(reg, t, i); }
+
+idx_t advance(region_t* reg, idx_t i, ts_t t) { return advance_tl<ival_t>(reg, i, t); }
+
+idx_t advance_compact(region_t* reg, idx_t i, ts_t t) { return advance_tl<cival_t>(reg, i, t); }
+
+char* fetch(region_t* reg, ts_t t, idx_t i, uint32_t bytes) { return fetch_tl<ival_t>(reg, t, i, bytes); }
+
+char* fetch_compact(region_t* reg, ts_t t, idx_t i, uint32_t bytes) { return fetch_tl<cival_t>(reg, t, i, bytes); }
+
+// Address of a field of a struct in a columnar region. Columns are laid
+// out back to back, the column of the field at byte offset `off` of the
+// struct starts at `off * capacity`.
+char* fetch_col(region_t* reg, idx_t i, uint32_t off, uint32_t bytes)
 {
-    while ((reg->tl[i & reg->mask].t + reg->tl[i & reg->mask].d) < t) { i++; }
-    return i;
+    auto capacity = static_cast<idx_t>(reg->mask) + 1;
+    return reg->data + (off * capacity) + ((i & reg->mask) * bytes);
 }
 
-char* fetch(region_t* reg, ts_t t, idx_t i, uint32_t bytes)
+// Regular regions have no gaps, so an event is present at every time
+// within the region
+char* fetch_regular(region_t* reg, ts_t t, idx_t i, uint32_t bytes)
 {
-    auto ivl = reg->tl[i & reg->mask];
-    return (t <= ivl.t) ? nullptr : (reg->data + ((i & reg->mask) * bytes));
+    return (t <= reg->st || reg->et < t) ? nullptr : fetch_col(reg, i, 0, bytes);
 }
 
 region_t* make_region(region_t* out_reg, region_t* in_reg, ts_t st, idx_t si, ts_t et, idx_t ei)
@@ -67,24 +161,50 @@ region_t* init_region(region_t* reg, ts_t t, uint32_t size, ival_t* tl, char* da
     return reg;
 }
 
+region_t* init_region_compact(region_t* reg, ts_t t, uint32_t size, cival_t* tl, char* data)
+{
+    reg->st = t;
+    reg->et = t;
+    reg->head = -1;
+    reg->count = 0;
+    reg->mask = size - 1;
+    reg->tl = reinterpret_cast<ival_t*>(tl);
+    reg->data = data;
+    commit_null_compact(reg, t);
+    return reg;
+}
+
 region_t* commit_data(region_t* reg, ts_t t)
 {
     auto last_ckpt = reg->et;
     reg->et = t;
     reg->head++;
     reg->count++;
+    set_ivl(reg, reg->head, last_ckpt, t - last_ckpt);
+    return reg;
+}
 
-    reg->tl[reg->head & reg->mask].t = last_ckpt;
-    reg->tl[reg->head & reg->mask].d = t - last_ckpt;
-
+region_t* commit_data_compact(region_t* reg, ts_t t)
+{
+    auto last_ckpt = reg->et;
+    reg->et = t;
+    reg->head++;
+    reg->count++;
+    set_civl(reg, reg->head, last_ckpt, t - last_ckpt);
     return reg;
 }
 
 region_t* commit_null(region_t* reg, ts_t t)
 {
     reg->et = t;
-    reg->tl[(reg->head + 1) & reg->mask].t = t;
-    reg->tl[(reg->head + 1) & reg->mask].d = 0;
+    set_ivl(reg, reg->head + 1, t, 0);
+    return reg;
+}
+
+region_t* commit_null_compact(region_t* reg, ts_t t)
+{
+    reg->et = t;
+    set_civl(reg, reg->head + 1, t, 0);
     return reg;
 }
 
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tilt/pass/fusion.h"
+#include "tilt/builder/tilder.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+using namespace std;
+
+namespace {
+
+// Rebuilds a value expression bottom-up, replacing the subexpressions for
+// which `fn` returns an expression. Other nodes are kept as they are.
+Expr rewrite(const Expr& expr, const function<Expr(const Expr&)>& fn)
+{
+    if (auto res = fn(expr)) { return res; }
+
+    auto rw = [&fn](const Expr& e) { return rewrite(e, fn); };
+    if (auto e = dynamic_pointer_cast<Cast>(expr)) {
+        return make_shared<Cast>(e->type.dtype, rw(e->arg));
+    } else if (auto e = dynamic_pointer_cast<NaryExpr>(expr)) {
+        vector<Expr> args;
+        for (const auto& arg : e->args) { args.push_back(rw(arg)); }
+        return make_shared<NaryExpr>(e->type.dtype, e->op, std::move(args));
+    } else if (auto e = dynamic_pointer_cast<Get>(expr)) {
+        return make_shared<Get>(rw(e->input), e->n);
+    } else if (auto e = dynamic_pointer_cast<New>(expr)) {
+        vector<Expr> inputs;
+        for (const auto& input : e->inputs) { inputs.push_back(rw(input)); }
+        return make_shared<New>(std::move(inputs));
+    } else if (auto e = dynamic_pointer_cast<Select>(expr)) {
+        return make_shared<Select>(rw(e->cond), rw(e->true_body), rw(e->false_body));
+    } else if (auto e = dynamic_pointer_cast<IfElse>(expr)) {
+        return make_shared<IfElse>(rw(e->cond), rw(e->true_body), rw(e->false_body));
+    } else if (auto e = dynamic_pointer_cast<Call>(expr)) {
+        vector<Expr> args;
+        for (const auto& arg : e->args) { args.push_back(rw(arg)); }
+        return make_shared<Call>(e->name, e->type, std::move(args));
+    }
+    return expr;
+}
+
+set<Sym> get_refs(const Expr& expr)
+{
+    set<Sym> refs;
+    walk(expr, [&refs](const Expr& e) {
+        if (auto sym = dynamic_pointer_cast<Symbol>(e)) { refs.insert(sym); }
+    });
+    return refs;
+}
+
+bool is_pointwise(const OpNode& op)
+{
+    if (!op.aux.empty()) { return false; }
+    for (const auto& in : op.inputs) {
+        if (in->type.is_beat()) { return false; }
+    }
+
+    bool pointwise = true;
+    auto check = [&pointwise](const Expr& e) {
+        if (auto elem = dynamic_pointer_cast<Element>(e)) {
+            pointwise &= (elem->pt.offset == 0) && !elem->lstream->type.is_out();
+        } else if (dynamic_pointer_cast<SubLStream>(e) || dynamic_pointer_cast<OpNode>(e)
+            || dynamic_pointer_cast<Reduce>(e)) {
+            pointwise = false;
+        }
+    };
+    for (const auto& [_, expr] : op.syms) {
+        walk(expr, check);
+    }
+    walk(op.pred, check);
+    return pointwise;
+}
+
+// Rewrites `cons`, which reads the output `x` of the point-wise operator
+// `prod`, to compute that output itself. The producer outputs an event at
+// every iteration where its predicate holds, and its iterations end at the
+// checkpoints of its inputs, so reading the inputs gives the consumer the
+// same iterations. Returns null if the consumer reads `x` other than at [0].
+Op fuse_pointwise(const OpNode& cons, const Sym& x, const OpNode& prod)
+{
+    if (!(cons.iter == prod.iter) || !cons.aux.empty() || !is_pointwise(prod)) { return nullptr; }
+    auto prod_out = prod.syms.find(prod.output);
+    if (prod_out == prod.syms.end()) { return nullptr; }
+
+    set<Sym> elems;
+    for (const auto& [sym, expr] : cons.syms) {
+        auto elem = dynamic_pointer_cast<Element>(expr);
+        if (elem && elem->lstream == x && elem->pt.offset == 0) {
+            elems.insert(sym);
+        }
+    }
+    if (elems.empty()) { return nullptr; }
+
+    bool other = false;
+    auto check = [&other, &x](const Expr& e) {
+        if (dynamic_pointer_cast<OpNode>(e) || dynamic_pointer_cast<Reduce>(e)) {
+            other = true;
+        } else if (auto sym = dynamic_pointer_cast<Symbol>(e)) {
+            other |= (sym == x);
+        }
+    };
+    for (const auto& [sym, expr] : cons.syms) {
+        if (!elems.count(sym)) { walk(expr, check); }
+    }
+    walk(cons.pred, check);
+    if (other) { return nullptr; }
+
+    // Events of the producer exist where its predicate holds
+    auto exists = [&elems, &prod](const Expr& e) -> Expr {
+        auto ex = dynamic_pointer_cast<Exists>(e);
+        return (ex && elems.count(ex->sym)) ? prod.pred : nullptr;
+    };
+    SymTable syms = prod.syms;
+    for (const auto& [sym, expr] : cons.syms) {
+        syms[sym] = elems.count(sym) ? prod_out->second : rewrite(expr, exists);
+    }
+
+    Params inputs;
+    auto add_input = [&inputs](const Sym& in) {
+        if (find(inputs.begin(), inputs.end(), in) == inputs.end()) { inputs.push_back(in); }
+    };
+    for (const auto& in : cons.inputs) {
+        if (in == x) {
+            for (const auto& prod_in : prod.inputs) { add_input(prod_in); }
+        } else {
+            add_input(in);
+        }
+    }
+
+    return make_shared<OpNode>(cons.iter, inputs, syms, rewrite(cons.pred, exists), cons.output, cons.aux);
+}
+
+// Inlines the symbols of an operator into `expr`, with `elem` standing for
+// `data`. Other symbols are inputs of the operator. Sets `ok` to false if
+// the expression reads anything else.
+Expr expand(const Expr& expr, const SymTable& syms, const Sym& elem, const Expr& data, bool& ok)
+{
+    return rewrite(expr, [&](const Expr& e) -> Expr {
+        if (auto sym = dynamic_pointer_cast<Symbol>(e)) {
+            if (sym == elem) { return data; }
+            auto it = syms.find(sym);
+            return (it != syms.end()) ? expand(it->second, syms, elem, data, ok) : sym;
+        } else if (dynamic_pointer_cast<Exists>(e) || dynamic_pointer_cast<Element>(e)
+            || dynamic_pointer_cast<SubLStream>(e) || dynamic_pointer_cast<OpNode>(e)
+            || dynamic_pointer_cast<Reduce>(e)) {
+            ok = false;
+            return e;
+        }
+        return nullptr;
+    });
+}
+
+// Rewrites a reduction over the output of the point-wise operator `prod`
+// into a reduction over the input of `prod`. The producer runs over one
+// period of the enclosing operator, so its input must be a window of the
+// same length, and has one event per event of its input where that event
+// exists.
+Expr fuse_reduce(const Reduce& red, const OpNode& prod, const OpNode& outer, const SymTable& outer_syms)
+{
+    if (!(prod.iter == Iter(0, 1)) || !is_pointwise(prod)) { return nullptr; }
+    auto pred = dynamic_pointer_cast<Exists>(prod.pred);
+    if (!pred || !prod.syms.count(pred->sym)) { return nullptr; }
+    auto elem = pred->sym;
+    auto elem_expr = dynamic_pointer_cast<Element>(prod.syms.at(elem));
+    if (!elem_expr) { return nullptr; }
+    auto in = elem_expr->lstream;
+
+    auto win = outer_syms.count(in) ? dynamic_pointer_cast<SubLStream>(outer_syms.at(in)) : nullptr;
+    if (!win || win->win.start.offset != -outer.iter.period || win->win.end.offset != 0) { return nullptr; }
+
+    Params args = red.args;
+    for (const auto& prod_in : prod.inputs) {
+        if (prod_in == in) { continue; }
+        if (!prod_in->type.is_val()) { return nullptr; }
+        if (find(args.begin(), args.end(), prod_in) == args.end()) { args.push_back(prod_in); }
+    }
+
+    bool ok = true;
+    auto data = _sym("data", Type(in->type.dtype));
+    expand(prod.output, prod.syms, elem, data, ok);
+    if (!ok) { return nullptr; }
+
+    auto acc = red.acc;
+    auto syms = prod.syms;
+    auto output = prod.output;
+    auto fuse = [syms, output, elem](AccTy acc) -> AccTy {
+        if (!acc) { return nullptr; }
+        return [acc, syms, output, elem](Expr s, Expr st, Expr et, Expr d) {
+            bool ok = true;
+            return acc(s, st, et, expand(output, syms, elem, d, ok));
+        };
+    };
+    return make_shared<Reduce>(in, red.state, fuse(red.acc), fuse(red.evict), args);
+}
+
+// Merges the reductions over the same stream that only depend on it into
+// one reduction over a struct of their states. Reductions with an evict
+// function are merged separately, so that they stay incremental.
+void merge_reduces(SymTable& syms)
+{
+    map<pair<Sym, bool>, vector<Sym>> groups;
+    for (const auto& [sym, expr] : syms) {
+        auto red = dynamic_pointer_cast<Reduce>(expr);
+        if (red && red->args.empty() && !red->state->type.dtype.is_struct() && get_refs(red->state).empty()) {
+            groups[{red->lstream, red->evict != nullptr}].push_back(sym);
+        }
+    }
+
+    for (auto& [key, group] : groups) {
+        if (group.size() < 2) { continue; }
+        sort(group.begin(), group.end(), [](const Sym& a, const Sym& b) { return a->name < b->name; });
+
+        vector<shared_ptr<Reduce>> reds;
+        vector<Expr> states;
+        for (const auto& sym : group) {
+            reds.push_back(dynamic_pointer_cast<Reduce>(syms.at(sym)));
+            states.push_back(reds.back()->state);
+        }
+        auto acc = [reds](Expr s, Expr st, Expr et, Expr d) -> Expr {
+            vector<Expr> res;
+            for (size_t i = 0; i < reds.size(); i++) {
+                res.push_back(reds[i]->acc(_get(s, i), st, et, d));
+            }
+            return _new(std::move(res));
+        };
+        AccTy evict = nullptr;
+        if (key.second) {
+            evict = [reds](Expr s, Expr st, Expr et, Expr d) -> Expr {
+                vector<Expr> res;
+                for (size_t i = 0; i < reds.size(); i++) {
+                    res.push_back(reds[i]->evict(_get(s, i), st, et, d));
+                }
+                return _new(std::move(res));
+            };
+        }
+        auto red = make_shared<Reduce>(key.first, _new(std::move(states)), acc, evict);
+        auto red_sym = _sym(group[0]->name + "_fused", red);
+        syms[red_sym] = red;
+        for (size_t i = 0; i < group.size(); i++) {
+            syms[group[i]] = _get(red_sym, i);
+        }
+    }
+}
+
+// Drops the symbols the operator no longer reads
+void prune(const OpNode& op, SymTable& syms)
+{
+    set<Sym> live;
+    vector<Sym> work;
+    auto mark = [&](const Expr& expr) {
+        for (const auto& sym : get_refs(expr)) {
+            if (live.insert(sym).second) { work.push_back(sym); }
+        }
+    };
+    mark(op.pred);
+    mark(op.output);
+    for (const auto& [sym, reg] : op.aux) {
+        mark(sym);
+        mark(reg);
+    }
+    while (!work.empty()) {
+        auto sym = work.back();
+        work.pop_back();
+        auto it = syms.find(sym);
+        if (it != syms.end()) { mark(it->second); }
+    }
+
+    for (auto it = syms.begin(); it != syms.end();) {
+        it = live.count(it->first) ? next(it) : syms.erase(it);
+    }
+}
+
+}  // namespace
+
+Op OpFusion::Build(const Op op)
+{
+    SymTable syms;
+    for (const auto& [sym, expr] : op->syms) {
+        auto inner = dynamic_pointer_cast<OpNode>(expr);
+        syms[sym] = inner ? Build(inner) : expr;
+    }
+
+    // Fusing a producer may expose the next one in a chain
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto& [sym, expr] : syms) {
+            if (auto cons = dynamic_pointer_cast<OpNode>(expr)) {
+                for (const auto& in : cons->inputs) {
+                    auto prod = syms.count(in) ? dynamic_pointer_cast<OpNode>(syms.at(in)) : nullptr;
+                    auto fused = prod ? fuse_pointwise(*cons, in, *prod) : nullptr;
+                    if (fused) {
+                        expr = fused;
+                        changed = true;
+                        break;
+                    }
+                }
+            } else if (auto red = dynamic_pointer_cast<Reduce>(expr)) {
+                auto prod = syms.count(red->lstream) ? dynamic_pointer_cast<OpNode>(syms.at(red->lstream)) : nullptr;
+                auto fused = prod ? fuse_reduce(*red, *prod, *op, syms) : nullptr;
+                if (fused) {
+                    expr = fused;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    merge_reduces(syms);
+    prune(*op, syms);
+    return make_shared<OpNode>(op->iter, op->inputs, syms, op->pred, op->output, op->aux);
+}
@@ -0,0 +1,194 @@
+#include <algorithm>
+
+#include "tilt/pass/hasher.h"
+#include "tilt/builder/tilder.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/SHA1.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+using namespace std;
+
+void IRHasher::emitnode(const string name, const vector<Expr> args)
+{
+    ostr << name << "(";
+    for (const auto& arg : args) {
+        arg->Accept(*this);
+        ostr << ",";
+    }
+    ostr << ")";
+}
+
+void IRHasher::emitdefs(const SymTable& syms)
+{
+    // Symbol tables are ordered by pointer, so sort the serialized
+    // definitions to make the output independent of allocation order.
+    vector<string> defs;
+    for (const auto& [sym, expr] : syms) {
+        defs.push_back(serialize(sym) + "=" + serialize(expr));
+    }
+    sort(defs.begin(), defs.end());
+
+    ostr << "{";
+    for (const auto& def : defs) {
+        ostr << def << ";";
+    }
+    ostr << "}";
+}
+
+void IRHasher::Visit(const Symbol& sym) { ostr << "$" << sym.name << ":" << sym.type.str(); }
+
+void IRHasher::Visit(const Out& out) { ostr << "out:" << out.type.str(); }
+
+void IRHasher::Visit(const Beat& beat) { ostr << "beat:" << beat.type.str(); }
+
+void IRHasher::Visit(const Call& call)
+{
+    emitnode("call:" + call.name + ":" + call.type.str(), call.args);
+}
+
+void IRHasher::Visit(const IfElse& ifelse)
+{
+    emitnode("ifelse", { ifelse.cond, ifelse.true_body, ifelse.false_body });
+}
+
+void IRHasher::Visit(const Select& select)
+{
+    emitnode("select", { select.cond, select.true_body, select.false_body });
+}
+
+void IRHasher::Visit(const Get& get) { emitnode("get:" + to_string(get.n), { get.input }); }
+
+void IRHasher::Visit(const New& _new) { emitnode("new", _new.inputs); }
+
+void IRHasher::Visit(const Exists& exists) { emitnode("exists", { exists.sym }); }
+
+void IRHasher::Visit(const ConstNode& cnst)
+{
+    ostr << "const:" << cnst.type.str() << ":" << hexfloat << cnst.val << defaultfloat;
+}
+
+void IRHasher::Visit(const Cast& e) { emitnode("cast:" + e.type.str(), { e.arg }); }
+
+void IRHasher::Visit(const NaryExpr& e)
+{
+    emitnode("nary:" + to_string(static_cast<int>(e.op)) + ":" + e.type.str(), e.args);
+}
+
+void IRHasher::Visit(const SubLStream& subls)
+{
+    ostr << "subls[" << subls.win.start.offset << ":" << subls.win.end.offset << "]";
+    emitnode("", { subls.lstream });
+}
+
+void IRHasher::Visit(const Element& elem)
+{
+    ostr << "elem[" << elem.pt.offset << "]";
+    emitnode("", { elem.lstream });
+}
+
+void IRHasher::Visit(const OpNode& op)
+{
+    ostr << "op" << op.iter.str();
+    emitnode("", vector<Expr>(op.inputs.begin(), op.inputs.end()));
+    emitdefs(op.syms);
+
+    ostr << "aux{";
+    vector<string> aux;
+    for (const auto& [sym, ref] : op.aux) {
+        aux.push_back(serialize(sym) + "=" + serialize(ref));
+    }
+    sort(aux.begin(), aux.end());
+    for (const auto& a : aux) {
+        ostr << a << ";";
+    }
+    ostr << "}";
+
+    emitnode("ret", { op.pred, op.output });
+}
+
+void IRHasher::Visit(const Reduce& red)
+{
+    auto st = _sym("st", Type(types::TIME));
+    auto et = _sym("et", Type(types::TIME));
+    auto data = _sym("data", Type(red.lstream->type.dtype));
+    vector<Expr> args = { red.lstream, red.state, red.acc(red.state, st, et, data) };
+    if (red.evict) {
+        args.push_back(red.evict(red.state, st, et, data));
+    }
+    args.insert(args.end(), red.args.begin(), red.args.end());
+    emitnode(red.evict ? "reduce_evict" : "reduce", args);
+}
+
+void IRHasher::Visit(const Fetch& fetch) { emitnode("fetch", { fetch.reg, fetch.time, fetch.idx }); }
+
+void IRHasher::Visit(const Read& read) { emitnode("read", { read.ptr }); }
+
+void IRHasher::Visit(const Write& write) { emitnode("write", { write.reg, write.ptr, write.data }); }
+
+void IRHasher::Visit(const Advance& adv) { emitnode("advance", { adv.reg, adv.idx, adv.time }); }
+
+void IRHasher::Visit(const GetCkpt& next) { emitnode("get_ckpt", { next.reg, next.time, next.idx }); }
+
+void IRHasher::Visit(const GetStartIdx& gsi) { emitnode("get_start_idx", { gsi.reg }); }
+
+void IRHasher::Visit(const GetEndIdx& gei) { emitnode("get_end_idx", { gei.reg }); }
+
+void IRHasher::Visit(const GetStartTime& gst) { emitnode("get_start_time", { gst.reg }); }
+
+void IRHasher::Visit(const GetEndTime& get) { emitnode("get_end_time", { get.reg }); }
+
+void IRHasher::Visit(const CommitData& commit) { emitnode("commit_data", { commit.reg, commit.time }); }
+
+void IRHasher::Visit(const CommitNull& commit) { emitnode("commit_null", { commit.reg, commit.time }); }
+
+void IRHasher::Visit(const AllocRegion& alloc)
+{
+    emitnode("alloc_region:" + alloc.type.str(), { alloc.size, alloc.start_time });
+}
+
+void IRHasher::Visit(const MakeRegion& mr)
+{
+    emitnode("make_region", { mr.reg, mr.st, mr.si, mr.et, mr.ei });
+}
+
+void IRHasher::Visit(const LoopNode& loop)
+{
+    ostr << "loop:" << loop.get_name() << ":" << loop.type.str() << "{";
+    for (const auto& inner_loop : loop.inner_loops) {
+        inner_loop->Accept(*this);
+    }
+    ostr << "}";
+
+    emitnode("inputs", vector<Expr>(loop.inputs.begin(), loop.inputs.end()));
+    emitnode("idxs", vector<Expr>(loop.idxs.begin(), loop.idxs.end()));
+    emitnode("body", { loop.t, loop.output, loop.exit_cond });
+
+    vector<string> states;
+    for (const auto& [var, base] : loop.state_bases) {
+        states.push_back(serialize(var) + "<-" + serialize(base));
+    }
+    sort(states.begin(), states.end());
+    ostr << "states{";
+    for (const auto& state : states) {
+        ostr << state << ";";
+    }
+    ostr << "}";
+
+    emitdefs(loop.syms);
+}
+
+string IRHasher::serialize(const Expr expr)
+{
+    IRHasher hasher;
+    expr->Accept(hasher);
+    return hasher.ostr.str();
+}
+
+string IRHasher::Hash(const string& str)
+{
+    return llvm::toHex(llvm::SHA1::hash(llvm::arrayRefFromStringRef(str)), true);
+}
+
+string IRHasher::Build(const Expr expr) { return Hash(serialize(expr)); }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <unordered_set>
 
 #include "tilt/pass/printer.h"
@@ -166,17 +167,26 @@ void IRPrinter::Visit(const Reduce& red)
     auto t_name = "t" + to_string(ctx.nesting + 1);
     auto t = _sym(t_name, Type(types::TIME));
     auto t_base = _sym("^" + t_name, Type(types::TIME));
-    auto res = red.acc(state_sym, t_base, t, e_sym);
-    auto red_op = _op(
-        _iter(0, 1),
-        Params{red.lstream, state_init_sym},
-        SymTable{
-            {e_sym, e},
-            {state_sym, res},
-        },
-        _exists(e_sym),
-        state_sym);
-    red_op->Accept(*this);
+    Params inputs{red.lstream, state_init_sym};
+    inputs.insert(inputs.end(), red.args.begin(), red.args.end());
+    auto red_op = [&](AccTy acc) {
+        return _op(
+            _iter(0, 1),
+            inputs,
+            SymTable{
+                {e_sym, e},
+                {state_sym, acc(state_sym, t_base, t, e_sym)},
+            },
+            _exists(e_sym),
+            state_sym);
+    };
+    red_op(red.acc)->Accept(*this);
+
+    // Reductions with an evict function print it as a second reduction
+    if (red.evict) {
+        ostr << " \\ ";
+        red_op(red.evict)->Accept(*this);
+    }
 }
 
 void IRPrinter::Visit(const Fetch& fetch)
@@ -332,8 +342,8 @@ void IRPrinter::Visit(const LoopNode& loop)
     emitcomment("set local variables");
     emitnewline();
     for (const auto& [sym, expr] : loop.syms) {
-        if (bases.find(sym) == bases.end() &&
-            loop.state_bases.find(sym) == loop.state_bases.end()) {
+        auto is_idx = find(loop.idxs.begin(), loop.idxs.end(), sym) != loop.idxs.end();
+        if (bases.find(sym) == bases.end() && !is_idx && sym != loop.t && sym != loop.output) {
             emitassign(sym, expr);
             emitnewline();
         }
@@ -65,4 +65,30 @@ void moving_sum_test();
 void norm_test();
 void resample_test();
 
+// engine tests
+void object_cache_test();
+void tiered_test();
+void parallel_compile_test();
+void remove_query_test();
+void aot_test();
+void compile_stats_test();
+void compile_error_test();
+void perf_map_test();
+void stream_test();
+void large_window_test();
+void region_pool_test();
+void columnar_test();
+void advance_test();
+void ingest_test();
+void eventlog_test();
+void regular_stream_test();
+void compact_timeline_test();
+void concurrent_region_test();
+void bounded_stream_test();
+void parallel_test();
+void keyed_test();
+void pipeline_test();
+void fusion_test();
+void sliding_window_test();
+
 #endif  // TEST_INCLUDE_TEST_BASE_H_
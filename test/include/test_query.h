@@ -2,6 +2,7 @@
 #define TEST_INCLUDE_TEST_QUERY_H_
 
 #include <string>
+#include <vector>
 
 #include "tilt/builder/tilder.h"
 
@@ -10,15 +11,22 @@ using namespace tilt;
 using namespace tilt::tilder;
 
 Op _Select(_sym, function<Expr(Expr)>);
+Op _Map(_sym, function<Expr(Expr)>);
 Op _MovingSum(_sym, int64_t, int64_t);
 Op _Join(_sym, _sym);
+Op _SelectSub(_sym, _sym);
 Op _WindowAvg(string, _sym, int64_t);
 Op _Norm(string, _sym, int64_t);
+vector<Op> _NormStages(string, _sym, int64_t);
 Op _Resample(string, _sym, int64_t, int64_t);
+Op _SlidingAvg(string, _sym, int64_t, int64_t);
+Op _SlidingVar(string, _sym, int64_t, int64_t);
+Op _Recompute(Op);
 
 Expr _Count(_sym);
 Expr _Sum(_sym);
 Expr _Average(_sym);
 Expr _StdDev(_sym);
+Expr _Variance(_sym);
 
 #endif  // TEST_INCLUDE_TEST_QUERY_H_
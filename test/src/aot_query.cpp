@@ -0,0 +1,22 @@
+#include <string>
+
+#include "tilt/builder/tilder.h"
+#include "tilt/engine/aot.h"
+
+using namespace tilt;
+using namespace tilt::tilder;
+
+Op tilt::aot_query(string name)
+{
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int32_t>(), _iter(0, -1)));
+    auto e = in_sym[_pt(0)];
+    auto e_sym = _sym("e", e);
+    auto sel = _mul(_get(e_sym, 0), _i32(2));
+    auto sel_sym = _sym("sel", sel);
+    return _op(
+        _iter(0, 1),
+        Params{ in_sym },
+        SymTable{ {e_sym, e}, {sel_sym, sel} },
+        _exists(e_sym),
+        sel_sym);
+}
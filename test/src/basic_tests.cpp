@@ -17,3 +17,27 @@ TEST(CastOpTests, CastTest) { cast_test(); }
 TEST(QuiltTest, MovingSumTest) { moving_sum_test(); }
 TEST(QuiltTest, NormTest) { norm_test(); }
 TEST(QuiltTest, ResampleTest) { resample_test(); }
+TEST(EngineTest, ObjectCacheTest) { object_cache_test(); }
+TEST(EngineTest, TieredTest) { tiered_test(); }
+TEST(EngineTest, ParallelCompileTest) { parallel_compile_test(); }
+TEST(EngineTest, RemoveQueryTest) { remove_query_test(); }
+TEST(EngineTest, AOTTest) { aot_test(); }
+TEST(EngineTest, CompileStatsTest) { compile_stats_test(); }
+TEST(EngineTest, CompileErrorTest) { compile_error_test(); }
+TEST(EngineTest, PerfMapTest) { perf_map_test(); }
+TEST(EngineTest, StreamTest) { stream_test(); }
+TEST(EngineTest, LargeWindowTest) { large_window_test(); }
+TEST(EngineTest, RegionPoolTest) { region_pool_test(); }
+TEST(EngineTest, ColumnarTest) { columnar_test(); }
+TEST(EngineTest, AdvanceTest) { advance_test(); }
+TEST(EngineTest, IngestTest) { ingest_test(); }
+TEST(EngineTest, EventLogTest) { eventlog_test(); }
+TEST(EngineTest, RegularStreamTest) { regular_stream_test(); }
+TEST(EngineTest, CompactTimelineTest) { compact_timeline_test(); }
+TEST(EngineTest, ConcurrentRegionTest) { concurrent_region_test(); }
+TEST(EngineTest, BoundedStreamTest) { bounded_stream_test(); }
+TEST(EngineTest, ParallelTest) { parallel_test(); }
+TEST(EngineTest, KeyedTest) { keyed_test(); }
+TEST(EngineTest, PipelineTest) { pipeline_test(); }
+TEST(EngineTest, FusionTest) { fusion_test(); }
+TEST(EngineTest, SlidingWindowTest) { sliding_window_test(); }
@@ -1,15 +1,34 @@
 #include <utility>
 #include <cmath>
+#include <cstring>
 #include <algorithm>
 #include <string>
 #include <numeric>
+#include <random>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <atomic>
+
+#include <unistd.h>
 
 #include "tilt/pass/codegen/loopgen.h"
 #include "tilt/pass/codegen/llvmgen.h"
 #include "tilt/pass/codegen/vinstr.h"
+#include "tilt/pass/codegen/pool.h"
+#include "tilt/pass/fusion.h"
 #include "tilt/engine/engine.h"
+#include "tilt/engine/stream.h"
+#include "tilt/engine/ingest.h"
+#include "tilt/engine/eventlog.h"
+#include "tilt/engine/concurrent.h"
+#include "tilt/engine/parallel.h"
+#include "tilt/engine/keyed.h"
+#include "tilt/engine/pipeline.h"
 
 #include "test_base.h"
+#include "aot_mul.h"
 
 using namespace tilt;
 using namespace tilt::tilder;
@@ -20,16 +39,63 @@ void run_op(string query_name, Op op, ts_t st, ts_t et, region_t* out_reg, regio
     auto loop = LoopGen::Build(op_sym, op.get());
 
     auto jit = ExecEngine::Get();
-    auto& llctx = jit->GetCtx();
-
-    auto llmod = LLVMGen::Build(loop, llctx);
-    jit->AddModule(std::move(llmod));
+    jit->AddLoop(loop);
 
     auto loop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) jit->Lookup(loop->get_name());
 
     loop_addr(st, et, out_reg, in_reg);
 }
 
+// Float events from `st` with payloads `i % 100`, gapped by `gap(i)` before
+// every seventh event if `gaps` is set, as a batch for `commit_batch`
+struct TestInput {
+    vector<ival_t> tl;
+    vector<float> data;
+    ts_t et;
+};
+
+static TestInput make_input(ts_t st, size_t len, bool gaps, function<dur_t(size_t)> dur = [](size_t) { return 1; },
+                            function<ts_t(size_t)> gap = [](size_t) { return 3; })
+{
+    TestInput in;
+    ts_t t = st;
+    for (size_t i = 0; i < len; i++) {
+        if (gaps && i % 7 == 0) {
+            t += gap(i);
+        }
+        in.tl.push_back({ t, dur(i) });
+        in.data.push_back(i % 100);
+        t += dur(i);
+    }
+    in.et = t;
+    return in;
+}
+
+static void init_input(region_t* reg, ts_t st, uint32_t size, vector<ival_t>& tl, vector<float>& data,
+                       const TestInput& in)
+{
+    tl.resize(size);
+    data.resize(size);
+    init_region(reg, st, size, tl.data(), reinterpret_cast<char*>(data.data()));
+    commit_batch(reg, in.tl.data(), reinterpret_cast<const char*>(in.data.data()), sizeof(float), in.tl.size());
+}
+
+// Both regions hold the same float events, bit for bit
+static void assert_same_events(region_t* out, region_t* ref)
+{
+    ASSERT_EQ(get_end_time(out), get_end_time(ref));
+    ASSERT_EQ(get_start_idx(out), get_start_idx(ref));
+    ASSERT_EQ(get_end_idx(out), get_end_idx(ref));
+    for (auto i = get_start_idx(ref); i <= get_end_idx(ref); i++) {
+        auto ivl = out->tl[i & out->mask];
+        auto ref_ivl = ref->tl[i & ref->mask];
+        ASSERT_EQ(ivl.t, ref_ivl.t);
+        ASSERT_EQ(ivl.d, ref_ivl.d);
+        ASSERT_EQ(memcmp(out->data + (i & out->mask) * sizeof(float),
+                         ref->data + (i & ref->mask) * sizeof(float), sizeof(float)), 0);
+    }
+}
+
 template<typename InTy, typename OutTy>
 void op_test(string query_name, Op op, ts_t st, ts_t et, QueryFn<InTy, OutTy> query_fn, vector<Event<InTy>> input)
 {
@@ -299,6 +365,33 @@ void moving_sum_test()
     unary_op_test<int32_t, int32_t>("moving_sum", mov_op, 0, len * dur, mov_query_fn, len, dur);
 }
 
+static vector<Event<float>> norm_fn(vector<Event<float>> in, int64_t w)
+{
+    vector<Event<float>> out(in.size());
+    size_t num_windows = in.size() / w;
+
+    for (size_t i = 0; i < num_windows; i++) {
+        float sum = 0.0, mean, variance = 0.0, std_dev;
+
+        for (size_t j = 0; j < w; j++) {
+            sum += in[i * w + j].payload;
+        }
+        mean = sum / w;
+        for (size_t j = 0; j < w; j++) {
+            variance += pow(in[i * w + j].payload - mean, 2);
+        }
+        std_dev = sqrt(variance / w);
+
+        for (size_t j = 0; j < w; j++) {
+            size_t idx = i * w + j;
+            float z_score = (in[idx].payload - mean) / std_dev;
+            out[idx] = {in[idx].st, in[idx].et, z_score};
+        }
+    }
+
+    return out;
+}
+
 void norm_test()
 {
     size_t len = 1000;
@@ -308,31 +401,7 @@ void norm_test()
     auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
     auto norm_op = _Norm("norm", in_sym, w);
 
-    auto norm_query_fn = [w] (vector<Event<float>> in) {
-        vector<Event<float>> out(in.size());
-        size_t num_windows = in.size() / w;
-
-        for (size_t i = 0; i < num_windows; i++) {
-            float sum = 0.0, mean, variance = 0.0, std_dev;
-
-            for (size_t j = 0; j < w; j++) {
-                sum += in[i * w + j].payload;
-            }
-            mean = sum / w;
-            for (size_t j = 0; j < w; j++) {
-                variance += pow(in[i * w + j].payload - mean, 2);
-            }
-            std_dev = sqrt(variance / w);
-
-            for (size_t j = 0; j < w; j++) {
-                size_t idx = i * w + j;
-                float z_score = (in[idx].payload - mean) / std_dev;
-                out[idx] = {in[idx].st, in[idx].et, z_score};
-            }
-        }
-
-        return std::move(out);
-    };
+    auto norm_query_fn = [w] (vector<Event<float>> in) { return norm_fn(in, w); };
 
     unary_op_test<float, float>("norm", norm_op, 0, len * dur, norm_query_fn, len, dur);
 }
@@ -374,3 +443,1361 @@ void resample_test()
     run_resample("down_sample1", 4, 5);
     run_resample("down_sample2", 3, 6);
 }
+
+void object_cache_test()
+{
+    auto cache_dir = std::filesystem::temp_directory_path() / "tilt_cache_test";
+    std::filesystem::remove_all(cache_dir);
+
+    auto jit = ExecEngine::Get();
+    auto& cache = jit->GetCache();
+    jit->SetCacheDir(cache_dir.string());
+
+    auto hits = cache.Hits();
+    auto misses = cache.Misses();
+    select_test<int32_t, int32_t>("cached_add",
+        [] (Expr s) { return _add(s, _i32(10)); },
+        [] (int32_t s) { return s + 10; });
+    ASSERT_EQ(hits, cache.Hits());
+    ASSERT_EQ(misses + 1, cache.Misses());
+
+    // Structurally identical loops map to the same cached object
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int32_t>(), _iter(0, -1)));
+    auto op = _Select(in_sym, [] (Expr s) { return _add(s, _i32(10)); });
+    auto loop = LoopGen::Build(_sym("cached_add", op), op.get());
+    auto key = jit->CacheKey(loop);
+    ASSERT_TRUE(std::filesystem::exists(cache_dir / (key + ".o")));
+    ASSERT_NE(cache.Load(key), nullptr);
+    ASSERT_EQ(hits + 1, cache.Hits());
+
+    // Queries compiled with fast-math are cached under their own key
+    auto fast_loop = jit->AddQuery(_sym("cached_fast_add", op), op, false, true);
+    jit->Lookup(fast_loop->get_name());
+    auto fast_key = jit->CacheKey(fast_loop, true);
+    ASSERT_NE(fast_key, key);
+    ASSERT_TRUE(std::filesystem::exists(cache_dir / (fast_key + ".o")));
+
+    // A cache smaller than any object evicts everything on the next store
+    jit->SetCacheDir(cache_dir.string(), 0);
+    select_test<int32_t, int32_t>("cached_sub",
+        [] (Expr s) { return _sub(s, _i32(10)); },
+        [] (int32_t s) { return s - 10; });
+    ASSERT_TRUE(std::filesystem::is_empty(cache_dir));
+
+    jit->SetCacheDir("");
+    std::filesystem::remove_all(cache_dir);
+}
+
+static void run_mul_loop(intptr_t addr, size_t len, int64_t dur, int32_t k)
+{
+    region_t in_reg;
+    auto in_tl = vector<ival_t>(len);
+    auto in_data = vector<int32_t>(len);
+    init_region(&in_reg, 0, get_buf_size(len), in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+    for (size_t i = 0; i < len; i++) {
+        commit_data(&in_reg, (i + 1) * dur);
+        *reinterpret_cast<int32_t*>(fetch(&in_reg, (i + 1) * dur, get_end_idx(&in_reg), sizeof(int32_t))) = i;
+    }
+
+    region_t out_reg;
+    auto out_tl = vector<ival_t>(len);
+    auto out_data = vector<int32_t>(len);
+    init_region(&out_reg, 0, get_buf_size(len), out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+
+    auto loop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) addr;
+    loop_addr(0, len * dur, &out_reg, &in_reg);
+
+    for (size_t i = 0; i < len; i++) {
+        ASSERT_EQ(out_tl[i].t, i * dur);
+        ASSERT_EQ(out_tl[i].d, dur);
+        ASSERT_EQ(out_data[i], i * k);
+    }
+}
+
+void tiered_test()
+{
+    size_t len = 1000;
+    int64_t dur = 5;
+
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int32_t>(), _iter(0, -1)));
+    auto op = _Select(in_sym, [] (Expr s) { return _mul(s, _i32(3)); });
+    auto loop = LoopGen::Build(_sym("tiered_mul", op), op.get());
+
+    auto jit = ExecEngine::Get();
+    auto query = jit->AddTieredLoop(loop);
+    ASSERT_NE(query->Addr(), 0);
+    ASSERT_GT(query->BaselineTime(), 0);
+
+    // Both tiers produce the same output
+    run_mul_loop(query->Addr(), len, dur, 3);
+    query->Wait();
+    ASSERT_EQ(query->GetTier(), Tier::OPTIMIZED);
+    ASSERT_GT(query->OptimizedTime(), 0);
+    run_mul_loop(query->Addr(), len, dur, 3);
+
+    // A loop already defined in the engine fails the optimized tier, and
+    // the query stays on its baseline
+    auto dup_loop = LoopGen::Build(_sym("tiered_dup", op), op.get());
+    jit->AddLoop(dup_loop);
+    auto dup = jit->AddTieredLoop(dup_loop);
+    ASSERT_THROW(dup->Wait(), CompileError);
+    ASSERT_EQ(dup->GetTier(), Tier::BASELINE);
+    run_mul_loop(dup->Addr(), len, dur, 3);
+}
+
+void parallel_compile_test()
+{
+    size_t len = 1000;
+    int64_t dur = 5;
+    int32_t num_queries = 8;
+
+    vector<tilt::Loop> loops;
+    for (int32_t k = 0; k < num_queries; k++) {
+        auto in_sym = _sym("in", tilt::Type(types::STRUCT<int32_t>(), _iter(0, -1)));
+        auto op = _Select(in_sym, [k] (Expr s) { return _mul(s, _i32(k)); });
+        loops.push_back(LoopGen::Build(_sym("parallel_mul" + to_string(k), op), op.get()));
+    }
+
+    auto jit = ExecEngine::Get();
+    auto addrs = jit->AddLoops(loops, 4);
+    ASSERT_EQ(addrs.size(), loops.size());
+
+    for (int32_t k = 0; k < num_queries; k++) {
+        ASSERT_NE(addrs[k], 0);
+        run_mul_loop(addrs[k], len, dur, k);
+    }
+}
+
+static size_t get_rss()
+{
+    ifstream statm("/proc/self/statm");
+    size_t size, resident;
+    statm >> size >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+void remove_query_test()
+{
+    size_t len = 100;
+    int64_t dur = 1;
+
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int32_t>(), _iter(0, -1)));
+    auto op = _Select(in_sym, [] (Expr s) { return _mul(s, _i32(2)); });
+    auto loop = LoopGen::Build(_sym("removable_mul", op), op.get());
+
+    auto jit = ExecEngine::Get();
+    auto deploy = [&]() {
+        jit->AddLoop(loop);
+        run_mul_loop(jit->Lookup(loop->get_name()), len, dur, 2);
+        jit->RemoveQuery(loop->get_name());
+    };
+
+    // Removed names can be registered again
+    for (int i = 0; i < 50; i++) {
+        deploy();
+    }
+
+    // Registering and dropping queries does not grow the memory footprint
+    auto rss = get_rss();
+    for (int i = 0; i < 200; i++) {
+        deploy();
+    }
+    ASSERT_LT(get_rss(), rss + (1 << 20));
+
+    // Tiered queries drop both tiers
+    auto query = jit->AddTieredLoop(loop);
+    jit->RemoveQuery(loop->get_name());
+    ASSERT_EQ(query->GetTier(), Tier::OPTIMIZED);
+
+    ASSERT_THROW(jit->RemoveQuery(loop->get_name()), std::runtime_error);
+}
+
+void aot_test()
+{
+    // `aot_mul` is compiled at build time by `tilt_add_query`
+    run_mul_loop((intptr_t) aot_mul, 1000, 5, 2);
+}
+
+void compile_stats_test()
+{
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int32_t>(), _iter(0, -1)));
+    auto op = _Select(in_sym, [] (Expr s) { return _mul(s, _i32(4)); });
+
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("stats_mul", op), op);
+    run_mul_loop(jit->Lookup(loop->get_name()), 1000, 5, 4);
+
+    auto stats = jit->GetStats(loop->get_name());
+    ASSERT_GT(stats.loopgen, 0);
+    ASSERT_GT(stats.llvmgen, 0);
+    ASSERT_GT(stats.optimize, 0);
+    ASSERT_GT(stats.codegen, 0);
+    ASSERT_GE(stats.link, 0);
+    ASSERT_TRUE(stats.linked);
+    ASSERT_FALSE(stats.cached);
+}
+
+void compile_error_test()
+{
+    EngineOptions opts;
+    opts.verify = true;
+    auto jit = ExecEngine::Create(opts);
+
+    // Function without a terminator
+    auto m = make_unique<llvm::Module>("broken", jit->GetCtx());
+    auto fn_type = llvm::FunctionType::get(llvm::Type::getVoidTy(jit->GetCtx()), false);
+    auto fn = llvm::Function::Create(fn_type, llvm::Function::ExternalLinkage, "broken_fn", m.get());
+    llvm::BasicBlock::Create(jit->GetCtx(), "entry", fn);
+
+    try {
+        jit->AddModule(std::move(m));
+        FAIL();
+    } catch (const CompileError& err) {
+        ASSERT_EQ(err.query, "broken");
+        ASSERT_EQ(err.phase, "verify");
+    }
+
+    try {
+        jit->Lookup("missing_fn");
+        FAIL();
+    } catch (const CompileError& err) {
+        ASSERT_EQ(err.query, "missing_fn");
+        ASSERT_EQ(err.phase, "link");
+    }
+}
+
+void perf_map_test()
+{
+    EngineOptions opts;
+    opts.perf_map = true;
+    opts.gdb = true;
+    auto jit = ExecEngine::Create(opts);
+
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int32_t>(), _iter(0, -1)));
+    auto op = _Select(in_sym, [] (Expr s) { return _mul(s, _i32(5)); });
+    auto loop = jit->AddQuery(_sym("perf_mul", op), op);
+    auto addr = jit->Lookup(loop->get_name());
+
+    // Every line is `<start> <size> <name>` with hexadecimal start and size
+    ifstream perf_map(PerfMapListener::Path());
+    ASSERT_TRUE(perf_map.is_open());
+    bool found = false;
+    string line;
+    while (getline(perf_map, line)) {
+        istringstream entry(line);
+        intptr_t start;
+        size_t size;
+        string name;
+        entry >> hex >> start >> size >> name;
+        if (name == loop->get_name()) {
+            ASSERT_EQ(start, addr);
+            ASSERT_GT(size, 0);
+            found = true;
+        }
+    }
+    ASSERT_TRUE(found);
+
+    std::filesystem::remove(PerfMapListener::Path());
+}
+
+void stream_test()
+{
+    size_t len = 1000;
+    int64_t w = 10;
+
+    auto in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    auto op = _MovingSum(in_sym, 1, w);
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("stream_moving_sum", op), op);
+
+    vector<ival_t> out_tl;
+    vector<int32_t> out_data;
+    auto sink = [&](const ival_t& ivl, const char* data) {
+        out_tl.push_back(ivl);
+        out_data.push_back(*reinterpret_cast<const int32_t*>(data));
+    };
+
+    // Chunks do not line up with the window or the batches
+    StreamDriver stream(jit->Lookup(loop->get_name()), {sizeof(int32_t)}, sizeof(int32_t), sink, 7, 128, w, 64);
+
+    std::srand(time(nullptr));
+    vector<int32_t> in_data(len);
+    for (size_t i = 0; i < len;) {
+        auto n = min<size_t>(1 + std::rand() % 50, len - i);
+        for (size_t j = i; j < i + n; j++) {
+            in_data[j] = std::rand() % 1000;
+            stream.Push(0, j, j + 1, reinterpret_cast<char*>(&in_data[j]));
+        }
+        i += n;
+        ASSERT_EQ(stream.Run(), i - i % 7);
+    }
+    ASSERT_EQ(stream.Flush(len), len);
+
+    ASSERT_EQ(out_tl.size(), len);
+    int32_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += in_data[i] - ((i < w) ? 0 : in_data[i - w]);
+        ASSERT_EQ(out_tl[i].t, i);
+        ASSERT_EQ(out_tl[i].d, 1);
+        ASSERT_EQ(out_data[i], sum);
+    }
+
+    // Filling the input to capacity before every run keeps the lookback
+    out_tl.clear();
+    out_data.clear();
+    size_t full = 127;
+    StreamDriver full_stream(jit->Lookup(loop->get_name()), {sizeof(int32_t)}, sizeof(int32_t), sink,
+                             full, full, w, full);
+    for (size_t i = 0; i < len; i++) {
+        full_stream.Push(0, i, i + 1, reinterpret_cast<char*>(&in_data[i]));
+        if ((i + 1) % full == 0) {
+            ASSERT_EQ(full_stream.Run(), i + 1);
+        }
+    }
+    ASSERT_EQ(full_stream.Flush(len), len);
+
+    ASSERT_EQ(out_data.size(), len);
+    sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += in_data[i] - ((i < w) ? 0 : in_data[i - w]);
+        ASSERT_EQ(out_data[i], sum);
+    }
+
+    // Watermarks off the chunk grid leave events after the last chunk
+    // unconsumed, and they keep counting against the input capacity
+    out_data.clear();
+    size_t cap = 100;
+    ts_t chunk = 64;
+    StreamDriver part_stream(jit->Lookup(loop->get_name()), {sizeof(int32_t)}, sizeof(int32_t), sink,
+                             chunk, cap, w, cap);
+    size_t pushed = 0;
+    ts_t t = 0;
+    while (pushed < len) {
+        for (auto end = min<size_t>(t + cap, len); pushed < end; pushed++) {
+            part_stream.Push(0, pushed, pushed + 1, reinterpret_cast<char*>(&in_data[pushed]));
+        }
+        if (pushed < len) {
+            ASSERT_THROW(part_stream.Push(0, pushed, pushed + 1, reinterpret_cast<char*>(&in_data[pushed])),
+                         std::runtime_error);
+        }
+        t = part_stream.Run();
+        ASSERT_EQ(t, pushed - pushed % chunk);
+    }
+    ASSERT_EQ(part_stream.Flush(len), len);
+
+    ASSERT_EQ(out_data.size(), len);
+    sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += in_data[i] - ((i < w) ? 0 : in_data[i - w]);
+        ASSERT_EQ(out_data[i], sum);
+    }
+}
+
+void large_window_test()
+{
+    // Windows of this size overflow the stack if intermediate regions are
+    // allocated with allocas
+    int64_t w = 1 << 21;
+    size_t len = w;
+
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto norm_op = _Norm("large_norm", in_sym, w);
+
+    // Each window holds `k` and `k + 2` in equal numbers, so that the float
+    // sums are exact regardless of the order of accumulation
+    vector<Event<float>> input(len);
+    std::mt19937 gen(42);
+    for (size_t i = 0; i < len; i += w) {
+        vector<float> vals(w);
+        for (int64_t j = 0; j < w; j++) {
+            vals[j] = static_cast<float>(i / w + 2 * (j % 2));
+        }
+        std::shuffle(vals.begin(), vals.end(), gen);
+        for (int64_t j = 0; j < w; j++) {
+            input[i + j] = {static_cast<ts_t>(i + j), static_cast<ts_t>(i + j + 1), vals[j]};
+        }
+    }
+
+    auto norm_query_fn = [w] (vector<Event<float>> in) { return norm_fn(in, w); };
+
+    op_test<float, float>("large_norm", norm_op, 0, len, norm_query_fn, input);
+}
+
+void region_pool_test()
+{
+    size_t len = 1000;
+    int64_t w = 100;
+
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto norm_op = _Norm("pool_norm", in_sym, w);
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("pool_norm", norm_op), norm_op);
+    auto loop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) jit->Lookup(loop->get_name());
+
+    region_t in_reg;
+    auto in_tl = vector<ival_t>(len);
+    auto in_data = vector<float>(len);
+    init_region(&in_reg, 0, get_buf_size(len), in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+    for (size_t i = 0; i < len; i++) {
+        commit_data(&in_reg, i + 1);
+        *reinterpret_cast<float*>(fetch(&in_reg, i + 1, get_end_idx(&in_reg), sizeof(float))) = i % 7;
+    }
+
+    region_t out_reg;
+    auto out_tl = vector<ival_t>(len);
+    auto out_data = vector<float>(len);
+    auto run = [&]() {
+        init_region(&out_reg, 0, get_buf_size(len), out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+        loop_addr(0, len, &out_reg, &in_reg);
+    };
+
+    // The first run fills the pool
+    run();
+    pool_stats_t before;
+    pool_stats(&before);
+
+    for (int i = 0; i < 10; i++) {
+        run();
+    }
+    pool_stats_t after;
+    pool_stats(&after);
+
+    // Steady state borrows the buffers allocated by the first run
+    ASSERT_EQ(after.allocs, before.allocs);
+    ASSERT_EQ(after.bytes, before.bytes);
+    ASSERT_GE(after.borrows - before.borrows, 10 * len / w);
+    ASSERT_EQ(after.borrows - before.borrows, after.returns - before.returns);
+    ASSERT_EQ(before.borrows, before.returns);
+}
+
+void columnar_test()
+{
+    size_t len = 1000;
+    int64_t dur = 2;
+
+    struct InEvent { int64_t id; float price; int32_t qty; double vol; };
+    struct OutEvent { double cost; int64_t id; };
+
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int64_t, float, int32_t, double>(), _iter(0, -1)));
+    auto op = _Map(in_sym, [](Expr e) {
+        auto cost = _mul(_cast(types::FLOAT64, _get(e, 1)), _cast(types::FLOAT64, _get(e, 2)));
+        return _new(vector<Expr>{ cost, _get(e, 0) });
+    });
+
+    EngineOptions opts;
+    opts.columnar = true;
+    auto jit = ExecEngine::Create(opts);
+    auto loop = jit->AddQuery(_sym("columnar_map", op), op);
+    auto loop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) jit->Lookup(loop->get_name());
+
+    // Fields are written to and read from their columns
+    auto size = get_buf_size(len);
+    region_t in_reg;
+    auto in_tl = vector<ival_t>(size);
+    auto in_data = vector<char>(size * sizeof(InEvent));
+    init_region(&in_reg, 0, size, in_tl.data(), in_data.data());
+    for (size_t i = 0; i < len; i++) {
+        commit_data(&in_reg, (i + 1) * dur);
+        auto idx = get_end_idx(&in_reg);
+        *reinterpret_cast<int64_t*>(fetch_col(&in_reg, idx, offsetof(InEvent, id), sizeof(int64_t))) = i;
+        *reinterpret_cast<float*>(fetch_col(&in_reg, idx, offsetof(InEvent, price), sizeof(float))) = i % 10 + 0.5;
+        *reinterpret_cast<int32_t*>(fetch_col(&in_reg, idx, offsetof(InEvent, qty), sizeof(int32_t))) = i % 7;
+        *reinterpret_cast<double*>(fetch_col(&in_reg, idx, offsetof(InEvent, vol), sizeof(double))) = -1;
+    }
+
+    region_t out_reg;
+    auto out_tl = vector<ival_t>(size);
+    auto out_data = vector<char>(size * sizeof(OutEvent));
+    init_region(&out_reg, 0, size, out_tl.data(), out_data.data());
+    loop_addr(0, len * dur, &out_reg, &in_reg);
+
+    // The id column of the output is contiguous
+    auto ids = reinterpret_cast<int64_t*>(fetch_col(&out_reg, 0, offsetof(OutEvent, id), sizeof(int64_t)));
+    for (size_t i = 0; i < len; i++) {
+        auto cost = *reinterpret_cast<double*>(fetch_col(&out_reg, i, offsetof(OutEvent, cost), sizeof(double)));
+        ASSERT_EQ(out_tl[i].t, i * dur);
+        ASSERT_EQ(out_tl[i].d, dur);
+        ASSERT_DOUBLE_EQ(cost, (i % 10 + 0.5) * (i % 7));
+        ASSERT_EQ(ids[i], i);
+    }
+}
+
+void advance_test()
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> gap_dist(0, 3);
+    std::uniform_int_distribution<int> dur_dist(1, 100);
+
+    // The ring wraps around several times, so the searches cross it
+    auto size = get_buf_size(100);
+    region_t reg;
+    auto tl = vector<ival_t>(size);
+    auto data = vector<int32_t>(size);
+    init_region(&reg, 0, size, tl.data(), reinterpret_cast<char*>(data.data()));
+
+    auto linear_advance = [&reg](idx_t i, ts_t t) {
+        while ((reg.tl[i & reg.mask].t + reg.tl[i & reg.mask].d) < t) { i++; }
+        return i;
+    };
+
+    for (int n = 0; n < 1000; n++) {
+        auto st = reg.et;
+        if (gap_dist(gen) == 0) {
+            st += dur_dist(gen);
+            commit_null(&reg, st);
+        }
+        commit_data(&reg, st + dur_dist(gen));
+
+        auto start = get_start_idx(&reg);
+        auto end = get_end_idx(&reg);
+        std::uniform_int_distribution<idx_t> idx_dist(start, end);
+        for (int k = 0; k < 10; k++) {
+            auto i = idx_dist(gen);
+            std::uniform_int_distribution<ts_t> time_dist(reg.tl[i & reg.mask].t, reg.et);
+            auto t = time_dist(gen);
+            ASSERT_EQ(advance(&reg, i, t), linear_advance(i, t));
+        }
+    }
+}
+
+void ingest_test()
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> gap_dist(0, 3);
+    std::uniform_int_distribution<int> dur_dist(1, 10);
+    std::uniform_int_distribution<uint32_t> batch_dist(0, 150);
+
+    struct Payload { int64_t a; float b; };
+
+    // Batches larger than the ring keep only their last events
+    auto size = get_buf_size(60);
+    region_t ref_reg, row_reg, col_reg;
+    vector<ival_t> ref_tl(size), row_tl(size), col_tl(size);
+    vector<Payload> ref_data(size), row_data(size), col_data(size);
+    init_region(&ref_reg, 0, size, ref_tl.data(), reinterpret_cast<char*>(ref_data.data()));
+    init_region(&row_reg, 0, size, row_tl.data(), reinterpret_cast<char*>(row_data.data()));
+    init_region(&col_reg, 0, size, col_tl.data(), reinterpret_cast<char*>(col_data.data()));
+
+    ts_t t = 0;
+    int64_t val = 0;
+    for (int n = 0; n < 100; n++) {
+        auto len = batch_dist(gen);
+        vector<ival_t> tl(len);
+        vector<Payload> rows(len);
+        vector<int64_t> col_a(len);
+        vector<float> col_b(len);
+        for (uint32_t j = 0; j < len; j++) {
+            t += (gap_dist(gen) == 0) ? dur_dist(gen) : 0;
+            tl[j] = { t, static_cast<dur_t>(dur_dist(gen)) };
+            t += tl[j].d;
+            rows[j] = { val, val / 2.0f };
+            col_a[j] = rows[j].a;
+            col_b[j] = rows[j].b;
+            val++;
+
+            if (tl[j].t > ref_reg.et) {
+                commit_null(&ref_reg, tl[j].t);
+            }
+            commit_data(&ref_reg, t);
+            *reinterpret_cast<Payload*>(fetch(&ref_reg, t, get_end_idx(&ref_reg), sizeof(Payload))) = rows[j];
+        }
+
+        commit_batch(&row_reg, tl.data(), reinterpret_cast<char*>(rows.data()), sizeof(Payload), len);
+
+        const char* cols[] = { reinterpret_cast<char*>(col_a.data()), reinterpret_cast<char*>(col_b.data()) };
+        uint32_t offs[] = { offsetof(Payload, a), offsetof(Payload, b) };
+        uint32_t sizes[] = { sizeof(int64_t), sizeof(float) };
+        commit_col_batch(&col_reg, tl.data(), cols, offs, sizes, 2, len);
+
+        for (auto reg : { &row_reg, &col_reg }) {
+            ASSERT_EQ(reg->et, ref_reg.et);
+            ASSERT_EQ(reg->head, ref_reg.head);
+            ASSERT_EQ(reg->count, ref_reg.count);
+        }
+        for (auto i = get_start_idx(&ref_reg); i <= get_end_idx(&ref_reg); i++) {
+            auto slot = i & ref_reg.mask;
+            auto& ref = ref_data[slot];
+            ASSERT_EQ(row_tl[slot].t, ref_tl[slot].t);
+            ASSERT_EQ(row_tl[slot].d, ref_tl[slot].d);
+            ASSERT_EQ(col_tl[slot].t, ref_tl[slot].t);
+            ASSERT_EQ(col_tl[slot].d, ref_tl[slot].d);
+            ASSERT_EQ(row_data[slot].a, ref.a);
+            ASSERT_EQ(row_data[slot].b, ref.b);
+            ASSERT_EQ(*reinterpret_cast<int64_t*>(fetch_col(&col_reg, i, offs[0], sizes[0])), ref.a);
+            ASSERT_EQ(*reinterpret_cast<float*>(fetch_col(&col_reg, i, offs[1], sizes[1])), ref.b);
+        }
+    }
+}
+
+void eventlog_test()
+{
+    size_t len = 1000;
+    auto path = (std::filesystem::temp_directory_path() / "tilt_eventlog_test.log").string();
+
+    // Events with gaps, appended one by one and in a batch
+    vector<ival_t> tl(len);
+    vector<int32_t> data(len);
+    ts_t t = 10;
+    for (size_t i = 0; i < len; i++) {
+        t += i % 3;
+        tl[i] = { t, static_cast<dur_t>(i % 4 + 1) };
+        t += tl[i].d;
+        data[i] = i;
+    }
+    {
+        EventLogWriter writer(path, sizeof(int32_t), 10);
+        for (size_t i = 0; i < len / 2; i++) {
+            writer.Append(tl[i].t, tl[i].t + tl[i].d, reinterpret_cast<char*>(&data[i]));
+        }
+        writer.Append(&tl[len / 2], reinterpret_cast<char*>(&data[len / 2]), len - len / 2);
+        ASSERT_THROW(writer.Append(0, 1, reinterpret_cast<char*>(&data[0])), std::runtime_error);
+    }
+
+    EventLog log(path);
+    ASSERT_EQ(log.Count(), len);
+    ASSERT_EQ(log.PayloadSize(), sizeof(int32_t));
+    auto in_reg = log.Region();
+    ASSERT_EQ(get_start_time(in_reg), 10);
+    ASSERT_EQ(get_end_time(in_reg), t);
+
+    auto in_sym = _sym("in", tilt::Type(types::STRUCT<int32_t>(), _iter(0, -1)));
+    auto op = _Select(in_sym, [] (Expr s) { return _mul(s, _i32(3)); });
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("eventlog_mul", op), op);
+    auto loop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) jit->Lookup(loop->get_name());
+
+    // The loop scans the mapped log directly
+    region_t out_reg;
+    auto out_tl = vector<ival_t>(get_buf_size(len));
+    auto out_data = vector<int32_t>(get_buf_size(len));
+    init_region(&out_reg, 10, get_buf_size(len), out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+    loop_addr(10, t, &out_reg, in_reg);
+
+    ASSERT_EQ(get_end_idx(&out_reg), len - 1);
+    for (size_t i = 0; i < len; i++) {
+        ASSERT_EQ(out_tl[i].t, tl[i].t);
+        ASSERT_EQ(out_tl[i].d, tl[i].d);
+        ASSERT_EQ(out_data[i], data[i] * 3);
+    }
+
+    // Offsets of a corrupt header are checked before the region is built
+    string bytes;
+    {
+        ifstream in(path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    auto bad_path = path + ".bad";
+    auto corrupt = [&](function<void(EventLogHeader&)> edit) {
+        auto bad = bytes;
+        EventLogHeader header;
+        memcpy(&header, bad.data(), sizeof(header));
+        edit(header);
+        memcpy(bad.data(), &header, sizeof(header));
+        ofstream out(bad_path, ios::binary | ios::trunc);
+        out << bad;
+    };
+    corrupt([](EventLogHeader& h) { h.tl_offset += 4; });
+    ASSERT_THROW(EventLog bad_log(bad_path), std::runtime_error);
+    corrupt([](EventLogHeader& h) { h.data_offset = ~4095ull; });
+    ASSERT_THROW(EventLog bad_log(bad_path), std::runtime_error);
+    std::filesystem::remove(bad_path);
+
+    // Files without the header are rejected
+    {
+        ofstream out(path, ios::binary | ios::trunc);
+        out << string(8192, 'x');
+    }
+    ASSERT_THROW(EventLog bad_log(path), std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+void regular_stream_test()
+{
+    size_t len = 1000;
+    int64_t dur = 2;
+    int64_t w = 20;
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> val_dist(0, 100000);
+    vector<Event<float>> input(len);
+    vector<float> payloads(len);
+    for (size_t i = 0; i < len; i++) {
+        payloads[i] = val_dist(gen);
+        input[i] = { static_cast<int64_t>(i) * dur, static_cast<int64_t>(i + 1) * dur, payloads[i] };
+    }
+    auto true_out = norm_fn(input, w / dur);
+
+    // The input region has no timeline and is filled in two batches
+    region_t in_reg;
+    auto in_data = vector<float>(get_buf_size(len));
+    init_regular_region(&in_reg, 0, dur, 0, get_buf_size(len), reinterpret_cast<char*>(in_data.data()));
+    ASSERT_EQ(get_start_idx(&in_reg), 0);
+    commit_regular_batch(&in_reg, dur, reinterpret_cast<char*>(payloads.data()), sizeof(float), len / 2);
+    commit_regular_batch(&in_reg, dur, reinterpret_cast<char*>(&payloads[len / 2]), sizeof(float), len - len / 2);
+    ASSERT_EQ(get_end_idx(&in_reg), len - 1);
+    ASSERT_EQ(get_end_time(&in_reg), len * dur);
+
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, dur), true));
+    auto norm_op = _Norm("regular_norm", in_sym, w);
+
+    region_t out_reg;
+    auto out_tl = vector<ival_t>(get_buf_size(len));
+    auto out_data = vector<float>(get_buf_size(len));
+    init_region(&out_reg, 0, get_buf_size(len), out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+    run_op("regular_norm", norm_op, 0, len * dur, &out_reg, &in_reg);
+
+    ASSERT_EQ(get_end_idx(&out_reg), len - 1);
+    for (size_t i = 0; i < len; i++) {
+        ASSERT_EQ(out_tl[i].t, true_out[i].st);
+        ASSERT_EQ(out_tl[i].t + out_tl[i].d, true_out[i].et);
+        ASSERT_FLOAT_EQ(out_data[i], true_out[i].payload);
+    }
+
+    // Points past the end of the input have no event
+    auto e = in_sym[_pt(0)];
+    auto e_sym = _sym("e", e);
+    auto copy_op = _op(_iter(0, dur), Params{ in_sym }, SymTable{ {e_sym, e} }, _exists(e_sym), e_sym);
+    init_region(&out_reg, 0, get_buf_size(len), out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+    run_op("regular_copy", copy_op, 0, (len + 10) * dur, &out_reg, &in_reg);
+
+    ASSERT_EQ(get_end_idx(&out_reg), len - 1);
+    for (size_t i = 0; i < len; i++) {
+        ASSERT_EQ(out_tl[i].t, input[i].st);
+        ASSERT_EQ(out_data[i], payloads[i]);
+    }
+}
+
+static void run_compact_test(string query_name, Op op, bool gaps)
+{
+    size_t len = 1000;
+
+    // Timestamps cross a multiple of 2^32. Events of the gap-free input
+    // have unit duration.
+    ts_t st = (3LL << 32) - 1008;
+    auto size = get_buf_size(len);
+    region_t in_reg, cin_reg;
+    auto in_tl = vector<ival_t>(size);
+    auto cin_tl = vector<cival_t>(size);
+    auto in_data = vector<float>(size);
+    auto cin_data = vector<float>(size);
+    init_region(&in_reg, st, size, in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+    init_region_compact(&cin_reg, st, size, cin_tl.data(), reinterpret_cast<char*>(cin_data.data()));
+    vector<ival_t> batch_tl;
+    vector<float> batch_data;
+    ts_t t = st;
+    for (size_t i = 0; i < len; i++) {
+        if (gaps && i % 7 == 0) {
+            t += 3;
+            commit_null(&in_reg, t);
+            commit_null_compact(&cin_reg, t);
+        }
+        auto et = t + (gaps ? 1 + i % 2 : 1);
+        batch_tl.push_back({ t, static_cast<dur_t>(et - t) });
+        batch_data.push_back(i % 10);
+        t = et;
+        commit_data(&in_reg, t);
+        commit_data_compact(&cin_reg, t);
+        *reinterpret_cast<float*>(fetch(&in_reg, t, get_end_idx(&in_reg), sizeof(float))) = i % 10;
+        *reinterpret_cast<float*>(fetch_compact(&cin_reg, t, get_end_idx(&cin_reg), sizeof(float))) = i % 10;
+    }
+
+    // Bulk ingestion builds the same compact region
+    region_t bin_reg;
+    auto bin_tl = vector<cival_t>(size);
+    auto bin_data = vector<float>(size);
+    init_region_compact(&bin_reg, st, size, bin_tl.data(), reinterpret_cast<char*>(bin_data.data()));
+    commit_batch_compact(&bin_reg, batch_tl.data(), reinterpret_cast<char*>(batch_data.data()), sizeof(float), len);
+    ASSERT_EQ(get_end_idx(&bin_reg), get_end_idx(&cin_reg));
+    ASSERT_EQ(get_end_time(&bin_reg), get_end_time(&cin_reg));
+    for (size_t i = 0; i < len; i++) {
+        ASSERT_EQ(bin_tl[i].t, cin_tl[i].t);
+        ASSERT_EQ(bin_tl[i].d, cin_tl[i].d);
+        ASSERT_EQ(bin_data[i], cin_data[i]);
+    }
+
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym(query_name + "_ref", op), op);
+    auto loop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) jit->Lookup(loop->get_name());
+
+    EngineOptions opts;
+    opts.compact_tl = true;
+    auto cjit = ExecEngine::Create(opts);
+    auto cloop = cjit->AddQuery(_sym(query_name, op), op);
+    auto cloop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) cjit->Lookup(cloop->get_name());
+
+    region_t out_reg, cout_reg;
+    auto out_tl = vector<ival_t>(size);
+    auto cout_tl = vector<cival_t>(size);
+    auto out_data = vector<float>(size);
+    auto cout_data = vector<float>(size);
+    init_region(&out_reg, st, size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+    init_region_compact(&cout_reg, st, size, cout_tl.data(), reinterpret_cast<char*>(cout_data.data()));
+    loop_addr(st, t, &out_reg, &in_reg);
+    cloop_addr(st, t, &cout_reg, &cin_reg);
+
+    // The compact output decodes to the same events
+    ASSERT_EQ(get_end_idx(&cout_reg), get_end_idx(&out_reg));
+    ASSERT_EQ(get_end_time(&cout_reg), get_end_time(&out_reg));
+    for (auto i = get_start_idx(&out_reg); i <= get_end_idx(&out_reg); i++) {
+        auto ivl = out_tl[i & out_reg.mask];
+        ASSERT_EQ(get_ckpt_compact(&cout_reg, st, i), ivl.t);
+        ASSERT_EQ(get_ckpt_compact(&cout_reg, ivl.t + 1, i), ivl.t + ivl.d);
+        auto cptr = fetch_compact(&cout_reg, ivl.t + 1, i, sizeof(float));
+        auto ptr = fetch(&out_reg, ivl.t + 1, i, sizeof(float));
+        ASSERT_EQ(cptr == nullptr, ptr == nullptr);
+        if (ptr) {
+            ASSERT_EQ(*reinterpret_cast<float*>(cptr), *reinterpret_cast<float*>(ptr));
+        }
+    }
+}
+
+void compact_timeline_test()
+{
+    ASSERT_EQ(sizeof(cival_t) * 2, sizeof(ival_t));
+
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto map_op = _Map(in_sym, [](Expr e) { return _add(e, _f32(3)); });
+    run_compact_test("compact_map", map_op, true);
+    auto norm_op = _Norm("compact_norm", in_sym, 10);
+    run_compact_test("compact_norm", norm_op, false);
+
+    // Runtime components reject the layouts they do not support
+    RegionLayout layout;
+    layout.compact = true;
+    ASSERT_THROW(ConcurrentRegion(sizeof(float), 16, 0, 0, layout), std::runtime_error);
+    ASSERT_THROW(ParallelExecutor(map_op, 0, sizeof(float), 1, 0, layout), std::runtime_error);
+    ASSERT_THROW(StreamDriver(0, {sizeof(float)}, sizeof(float), StreamDriver::Sink(), 1, 16, 0, 16, 0, layout),
+                 std::runtime_error);
+}
+
+void concurrent_region_test()
+{
+    size_t len = 50000;
+    int64_t w = 10;
+
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> gap_dist(0, 3);
+    std::uniform_int_distribution<int> dur_dist(1, 5);
+    std::uniform_int_distribution<int> batch_dist(1, 16);
+    vector<ival_t> tl(len);
+    vector<int32_t> data(len);
+    ts_t t = 0;
+    for (size_t i = 0; i < len; i++) {
+        t += (gap_dist(gen) == 0) ? dur_dist(gen) : 0;
+        tl[i] = { t, static_cast<dur_t>(dur_dist(gen)) };
+        t += tl[i].d;
+        data[i] = i % 100;
+    }
+    auto end = t;
+
+    auto in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    auto op = _MovingSum(in_sym, 1, w);
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("concurrent_moving_sum", op), op);
+    auto loop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) jit->Lookup(loop->get_name());
+
+    // Reference run over the whole input
+    auto size = get_buf_size(end);
+    region_t in_reg, ref_reg;
+    auto in_tl = vector<ival_t>(get_buf_size(len));
+    auto in_data = vector<int32_t>(get_buf_size(len));
+    init_region(&in_reg, 0, get_buf_size(len), in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+    commit_batch(&in_reg, tl.data(), reinterpret_cast<char*>(data.data()), sizeof(int32_t), len);
+    auto ref_tl = vector<ival_t>(size);
+    auto ref_data = vector<int32_t>(size);
+    init_region(&ref_reg, 0, size, ref_tl.data(), reinterpret_cast<char*>(ref_data.data()));
+    loop_addr(0, end, &ref_reg, &in_reg);
+
+    // Rings much smaller than the input keep the producer waiting for the
+    // consumer, and batches may be larger than the free space. Gaps are
+    // published ahead of the events after them.
+    for (size_t capacity : { 16, 64, 1024 }) {
+        ConcurrentRegion creg(sizeof(int32_t), capacity, w);
+        std::thread producer([&]() {
+            size_t i = 0;
+            while (i < len) {
+                auto n = std::min<size_t>(batch_dist(gen), len - i);
+                if (i > 0 && tl[i].t > tl[i - 1].t + tl[i - 1].d) {
+                    creg.Advance(tl[i].t);
+                }
+                if (n == 1) {
+                    creg.Push(tl[i].t, tl[i].t + tl[i].d, reinterpret_cast<char*>(&data[i]));
+                } else {
+                    creg.Push(&tl[i], reinterpret_cast<char*>(&data[i]), n);
+                }
+                i += n;
+            }
+        });
+
+        region_t out_reg;
+        auto out_tl = vector<ival_t>(size);
+        auto out_data = vector<int32_t>(size);
+        init_region(&out_reg, 0, size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+        ts_t out_t = 0;
+        while (out_t < end) {
+            auto wm = creg.Watermark();
+            if (wm == out_t) {
+                std::this_thread::yield();
+                continue;
+            }
+            region_t snap;
+            loop_addr(out_t, wm, &out_reg, creg.Snapshot(&snap));
+            creg.Release(wm);
+            out_t = wm;
+        }
+        producer.join();
+
+        ASSERT_EQ(get_end_idx(&out_reg), get_end_idx(&ref_reg));
+        for (idx_t i = 0; i <= get_end_idx(&ref_reg); i++) {
+            ASSERT_EQ(out_tl[i].t, ref_tl[i].t);
+            ASSERT_EQ(out_tl[i].d, ref_tl[i].d);
+            ASSERT_EQ(out_data[i], ref_data[i]);
+        }
+    }
+}
+
+void bounded_stream_test()
+{
+    size_t len = 10000;
+    int64_t w = 10;
+
+    auto in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    auto op = _MovingSum(in_sym, 1, w);
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("bounded_moving_sum", op), op, true);
+
+    // The sink takes a random part of every batch, and sometimes nothing
+    std::mt19937 gen(42);
+    vector<ival_t> out_tl;
+    vector<int32_t> out_data;
+    auto sink = [&](const ival_t* tl, const char* data, size_t n) {
+        auto k = std::uniform_int_distribution<size_t>(0, n)(gen);
+        for (size_t i = 0; i < k; i++) {
+            out_tl.push_back(tl[i]);
+            out_data.push_back(reinterpret_cast<const int32_t*>(data)[i]);
+        }
+        return k;
+    };
+
+    // A single chunk covers the whole stream, with an output ring far
+    // smaller than its outputs
+    StreamDriver stream(jit->Lookup(loop->get_name()), {sizeof(int32_t)}, sizeof(int32_t), sink, len, len, w, 16);
+
+    vector<int32_t> in_data(len);
+    for (size_t i = 0; i < len; i++) {
+        in_data[i] = i % 1000;
+        stream.Push(0, i, i + 1, reinterpret_cast<char*>(&in_data[i]));
+    }
+    while (stream.Run() < static_cast<ts_t>(len) || stream.Pending() > 0) {
+        ASSERT_LE(stream.Pending(), 64);
+    }
+
+    ASSERT_EQ(out_tl.size(), len);
+    int32_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += in_data[i] - ((i < w) ? 0 : in_data[i - w]);
+        ASSERT_EQ(out_tl[i].t, i);
+        ASSERT_EQ(out_tl[i].d, 1);
+        ASSERT_EQ(out_data[i], sum);
+    }
+}
+
+static void run_parallel_test(string query_name, Op op, bool gaps, int64_t max_dur = 1)
+{
+    size_t len = 20000;
+
+    // Events of up to `max_dur` make iterations of a single run span chunk
+    // boundaries, which the parallel run must reproduce exactly
+    auto in = make_input(0, len, gaps, [max_dur](size_t i) { return 1 + (i * 7) % max_dur; });
+    region_t in_reg;
+    vector<ival_t> in_tl;
+    vector<float> in_data;
+    init_input(&in_reg, 0, get_buf_size(2 * len), in_tl, in_data, in);
+    auto end = in.et - in.et % op->iter.period;
+    auto out_buf = get_buf_size(ParallelExecutor::MaxOutputs(op.get(), end));
+
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym(query_name, op), op);
+    auto addr = jit->Lookup(loop->get_name());
+    auto loop_addr = (region_t* (*)(ts_t, ts_t, region_t*, region_t*)) addr;
+
+    region_t ref_reg;
+    auto ref_tl = vector<ival_t>(out_buf);
+    auto ref_data = vector<float>(out_buf);
+    init_region(&ref_reg, 0, out_buf, ref_tl.data(), reinterpret_cast<char*>(ref_data.data()));
+    loop_addr(0, end, &ref_reg, &in_reg);
+
+    for (auto [threads, chunk] : vector<pair<unsigned, ts_t>>{{1, 0}, {4, 0}, {4, 3 * op->iter.period}}) {
+        ParallelExecutor exec(op, addr, sizeof(float), threads, chunk);
+        region_t out_reg;
+        auto out_tl = vector<ival_t>(out_buf);
+        auto out_data = vector<float>(out_buf);
+        init_region(&out_reg, 0, out_buf, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+        exec.Run(0, end, &out_reg, {&in_reg});
+        assert_same_events(&out_reg, &ref_reg);
+    }
+}
+
+void parallel_test()
+{
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto map_op = _Map(in_sym, [](Expr e) { return _add(e, _f32(3)); });
+    auto norm_op = _Norm("parallel_norm", in_sym, 1000);
+
+    // Sliding window sum, whose windows overlap the previous chunk
+    auto sliding = [in_sym](string name) {
+        auto win = in_sym[_win(-100, 0)];
+        auto win_sym = _sym("win", win);
+        auto sum = _red(win_sym, _f32(0), [](Expr s, Expr st, Expr et, Expr d) { return _add(s, d); });
+        auto sum_sym = _sym(name + "_sum", sum);
+        return _op(_iter(0, 10), Params{ in_sym }, SymTable{ {win_sym, win}, {sum_sym, sum} }, _true(), sum_sym);
+    };
+    auto sliding_op = sliding("parallel_sliding");
+
+    ASSERT_EQ(ParallelExecutor::Lookback(map_op.get()), vector<int64_t>{0});
+    ASSERT_EQ(ParallelExecutor::Lookback(norm_op.get()), vector<int64_t>{0});
+    ASSERT_EQ(ParallelExecutor::Lookback(sliding_op.get()), vector<int64_t>{90});
+
+    auto int_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    ASSERT_TRUE(ParallelExecutor::ReadsOutput(_MovingSum(int_sym, 1, 10).get()));
+    ASSERT_FALSE(ParallelExecutor::ReadsOutput(norm_op.get()));
+
+    // Inputs are checked before any chunk runs
+    auto wide_in = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    Params wide_ins{ wide_in };
+    for (int i = 1; i < 5; i++) {
+        wide_ins.push_back(_sym("in" + to_string(i), tilt::Type(types::FLOAT32, _iter(0, -1))));
+    }
+    auto wide_e = wide_in[_pt(0)];
+    auto wide_sym = _sym("e", wide_e);
+    auto wide_op = _op(_iter(0, 1), wide_ins, SymTable{ {wide_sym, wide_e} }, _exists(wide_sym), wide_sym);
+    region_t wide_reg;
+    vector<ival_t> wide_tl(2);
+    vector<float> wide_data(2);
+    init_region(&wide_reg, 0, 2, wide_tl.data(), reinterpret_cast<char*>(wide_data.data()));
+    ParallelExecutor wide_exec(wide_op, 0, sizeof(float), 4, 1);
+    ASSERT_THROW(wide_exec.Run(0, 100, &wide_reg, vector<region_t*>(5, &wide_reg)), std::runtime_error);
+
+    run_parallel_test("parallel_map", map_op, true);
+    run_parallel_test("parallel_sliding", sliding_op, false);
+    run_parallel_test("parallel_norm", norm_op, false);
+    run_parallel_test("parallel_long_map", map_op, true, 8);
+    run_parallel_test("parallel_long_sliding", sliding("parallel_long_sliding"), true, 50);
+}
+
+void keyed_test()
+{
+    size_t len = 20000;
+    size_t nkeys = 50;
+    int64_t w = 10;
+    ts_t chunk = 64;
+    ts_t step = 1000;
+
+    auto in_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    auto op = _MovingSum(in_sym, 1, w);
+    auto jit = ExecEngine::Get();
+    auto loop = jit->AddQuery(_sym("keyed_moving_sum", op), op);
+    auto addr = jit->Lookup(loop->get_name());
+
+    // Low keys are much more frequent than high ones
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<size_t> key_dist(0, nkeys - 1);
+    vector<uint64_t> keys(len);
+    vector<int32_t> data(len);
+    vector<bool> seen(nkeys);
+    for (size_t i = 0; i < len; i++) {
+        keys[i] = key_dist(gen) * key_dist(gen) / nkeys;
+        data[i] = i % 100;
+        seen[keys[i]] = true;
+    }
+
+    // Reference runs every key on its own driver, one after another
+    vector<vector<pair<ival_t, int32_t>>> ref_outs(nkeys);
+    vector<unique_ptr<StreamDriver>> drivers;
+    for (size_t k = 0; k < nkeys; k++) {
+        auto sink = [&ref_outs, k](const ival_t& ivl, const char* data) {
+            ref_outs[k].emplace_back(ivl, *reinterpret_cast<const int32_t*>(data));
+        };
+        drivers.push_back(make_unique<StreamDriver>(addr, vector<uint32_t>{sizeof(int32_t)}, sizeof(int32_t), sink,
+                                                    chunk, 2 * step, w, 2 * chunk));
+    }
+
+    vector<vector<pair<ival_t, int32_t>>> outs(nkeys);
+    ts_t last = 0;
+    auto sink = [&](uint64_t key, const ival_t& ivl, const char* data) {
+        ASSERT_GE(ivl.t, last);
+        last = ivl.t;
+        outs[key].emplace_back(ivl, *reinterpret_cast<const int32_t*>(data));
+    };
+    KeyedExecutor exec(addr, sizeof(int32_t), sizeof(int32_t), sink, chunk, 2 * step, w, 2 * chunk, 4);
+
+    for (size_t i = 0; i < len; i++) {
+        auto payload = reinterpret_cast<char*>(&data[i]);
+        exec.Push(keys[i], i, i + 1, payload);
+        drivers[keys[i]]->Push(0, i, i + 1, payload);
+        if ((i + 1) % step == 0) {
+            ASSERT_EQ(exec.Run(i + 1), i + 1);
+            for (auto& driver : drivers) {
+                driver->Flush(i + 1);
+            }
+        }
+    }
+
+    ASSERT_EQ(exec.Keys(), static_cast<size_t>(std::count(seen.begin(), seen.end(), true)));
+    for (size_t k = 0; k < nkeys; k++) {
+        ASSERT_EQ(outs[k].size(), ref_outs[k].size());
+        for (size_t i = 0; i < outs[k].size(); i++) {
+            ASSERT_EQ(outs[k][i].first.t, ref_outs[k][i].first.t);
+            ASSERT_EQ(outs[k][i].first.d, ref_outs[k][i].first.d);
+            ASSERT_EQ(outs[k][i].second, ref_outs[k][i].second);
+        }
+    }
+
+    // Tasks that throw still let the others run, and the pool stays usable
+    WorkStealingPool pool(4);
+    atomic<size_t> done(0);
+    vector<function<void()>> tasks;
+    for (size_t i = 0; i < 64; i++) {
+        tasks.push_back([&done, i]() {
+            if (i % 16 == 3) { throw std::runtime_error("task " + to_string(i)); }
+            done++;
+        });
+    }
+    ASSERT_THROW(pool.Run(tasks), std::runtime_error);
+    ASSERT_EQ(done, 60u);
+    tasks.resize(3);
+    pool.Run(tasks);
+    ASSERT_EQ(done, 63u);
+}
+
+void pipeline_test()
+{
+    size_t len = 20000;
+    int64_t w = 1000;
+
+    auto size = get_buf_size(len);
+    region_t in_reg;
+    auto in_tl = vector<ival_t>(size);
+    auto in_data = vector<float>(size);
+    init_region(&in_reg, 0, size, in_tl.data(), reinterpret_cast<char*>(in_data.data()));
+    for (size_t i = 0; i < len; i++) {
+        commit_data(&in_reg, i + 1);
+        *reinterpret_cast<float*>(fetch(&in_reg, i + 1, get_end_idx(&in_reg), sizeof(float))) = i % 100;
+    }
+
+    // `_Norm` split in two stages, followed by a sliding sum whose windows
+    // reach into the previous chunk
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto map_op = _Map(in_sym, [](Expr e) { return _add(e, _f32(3)); });
+    auto map_sym = _sym("pipeline_map", map_op);
+    auto norm_ops = _NormStages("pipeline_norm", map_sym, w);
+    auto sub_op = norm_ops[0];
+    auto sub_sym = _sym("pipeline_norm_sub", sub_op);
+    auto div_op = norm_ops[1];
+    auto div_sym = _sym("pipeline_norm_div", div_op);
+    auto win = div_sym[_win(-100, 0)];
+    auto win_sym = _sym("win", win);
+    auto sum = _red(win_sym, _f32(0), [](Expr s, Expr st, Expr et, Expr d) { return _add(s, d); });
+    auto sum_sym = _sym("pipeline_sliding_sum", sum);
+    auto sliding_op = _op(_iter(0, 10), Params{ div_sym }, SymTable{ {win_sym, win}, {sum_sym, sum} },
+                          _true(), sum_sym);
+    auto sliding_sym = _sym("pipeline_sliding", sliding_op);
+
+    auto jit = ExecEngine::Get();
+    vector<PipelineExecutor::Stage> stages;
+    for (auto& [sym, op] : vector<pair<Sym, Op>>{
+            {map_sym, map_op}, {sub_sym, sub_op}, {div_sym, div_op}, {sliding_sym, sliding_op}}) {
+        auto loop = jit->AddQuery(sym, op);
+        stages.push_back({op, jit->Lookup(loop->get_name()), sizeof(float)});
+    }
+
+    // Reference runs the stages one after another over the whole input
+    vector<vector<ival_t>> ref_tls;
+    vector<vector<float>> ref_datas;
+    vector<region_t> ref_regs(stages.size());
+    auto ref_in = &in_reg;
+    for (size_t k = 0; k < stages.size(); k++) {
+        ref_tls.emplace_back(size);
+        ref_datas.emplace_back(size);
+        init_region(&ref_regs[k], 0, size, ref_tls[k].data(), reinterpret_cast<char*>(ref_datas[k].data()));
+        call_loop(stages[k].addr, 0, len, &ref_regs[k], &ref_in, 1);
+        ref_in = &ref_regs[k];
+    }
+    auto& ref_reg = ref_regs.back();
+
+    // The split stages compute `_Norm` as a whole
+    ASSERT_THROW(PipelineExecutor::Split(map_op, { map_sym }), std::runtime_error);
+    region_t norm_reg;
+    auto norm_tl = vector<ival_t>(size);
+    auto norm_data = vector<float>(size);
+    init_region(&norm_reg, 0, size, norm_tl.data(), reinterpret_cast<char*>(norm_data.data()));
+    run_op("pipeline_norm_whole", _Norm("pipeline_norm_whole", map_sym, w), 0, len, &norm_reg, &ref_regs[0]);
+    assert_same_events(&norm_reg, &ref_regs[2]);
+
+    for (auto [chunk, depth] : vector<pair<ts_t, size_t>>{{w, 1}, {w, 2}, {3 * w, 4}}) {
+        PipelineExecutor exec(stages, chunk, depth);
+        region_t out_reg;
+        auto out_tl = vector<ival_t>(size);
+        auto out_data = vector<float>(size);
+        init_region(&out_reg, 0, size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+        exec.Run(0, len, &out_reg, &in_reg);
+
+        ASSERT_EQ(get_end_time(&out_reg), get_end_time(&ref_reg));
+        ASSERT_EQ(get_end_idx(&out_reg), get_end_idx(&ref_reg));
+        for (idx_t i = 0; i <= get_end_idx(&ref_reg); i++) {
+            ASSERT_EQ(out_tl[i].t, ref_tls.back()[i].t);
+            ASSERT_EQ(out_tl[i].d, ref_tls.back()[i].d);
+            ASSERT_EQ(memcmp(&out_data[i], &ref_datas.back()[i], sizeof(float)), 0);
+        }
+
+        ASSERT_EQ(exec.Utilization().size(), stages.size());
+        for (auto util : exec.Utilization()) {
+            ASSERT_GE(util, 0);
+            ASSERT_LE(util, 1);
+        }
+    }
+}
+
+static void run_fusion_test(string query_name, function<Op(string, _sym)> build, bool gaps)
+{
+    size_t len = 20000;
+
+    auto size = get_buf_size(2 * len);
+    auto in = make_input(0, len, gaps);
+    region_t in_reg;
+    vector<ival_t> in_tl;
+    vector<float> in_data;
+    init_input(&in_reg, 0, size, in_tl, in_data, in);
+
+    // Fusion keeps the symbol names, so the fused query is built separately
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto op = build(query_name, in_sym);
+    auto fused_op = OpFusion::Build(build(query_name + "_fused", in_sym));
+    auto end = in.et - in.et % op->iter.period;
+
+    region_t ref_reg;
+    auto ref_tl = vector<ival_t>(size);
+    auto ref_data = vector<float>(size);
+    init_region(&ref_reg, 0, size, ref_tl.data(), reinterpret_cast<char*>(ref_data.data()));
+    run_op(query_name, op, 0, end, &ref_reg, &in_reg);
+
+    region_t out_reg;
+    auto out_tl = vector<ival_t>(size);
+    auto out_data = vector<float>(size);
+    init_region(&out_reg, 0, size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+    run_op(query_name + "_fused", fused_op, 0, end, &out_reg, &in_reg);
+    assert_same_events(&out_reg, &ref_reg);
+}
+
+void fusion_test()
+{
+    // Map -> Map -> Reduce and Map -> Map -> Select chains over a window,
+    // next to a count over the same window
+    auto chain = [](string name, _sym in) -> Op {
+        auto win = in[_win(-10, 0)];
+        auto win_sym = _sym("win", win);
+        auto a = _Map(win_sym, [](Expr e) { return _add(e, _f32(3)); });
+        auto a_sym = _sym(name + "_a", a);
+        auto b = _Map(a_sym, [](Expr e) { return _mul(e, _f32(2)); });
+        auto b_sym = _sym(name + "_b", b);
+        auto sum = _Sum(b_sym);
+        auto sum_sym = _sym(name + "_sum", sum);
+        auto count = _Count(win_sym);
+        auto count_sym = _sym(name + "_count", count);
+        auto avg = sum_sym / count_sym;
+        auto avg_sym = _sym("avg", avg);
+        auto sub = _SelectSub(b_sym, avg_sym);
+        auto sub_sym = _sym(name + "_sub", sub);
+        return _op(
+            _iter(0, 10),
+            Params{ in },
+            SymTable{
+                {win_sym, win}, {a_sym, a}, {b_sym, b}, {sum_sym, sum},
+                {count_sym, count}, {avg_sym, avg}, {sub_sym, sub}
+            },
+            _true(),
+            sub_sym);
+    };
+    auto norm = [](string name, _sym in) { return _Norm(name, in, 100); };
+    auto window_avg = [](string name, _sym in) { return _WindowAvg(name, in, 100); };
+
+    // Nested operators and reductions left after fusion
+    auto count_nodes = [](Op op) {
+        size_t ops = 0, reds = 0;
+        for (const auto& [_, expr] : op->syms) {
+            ops += (dynamic_pointer_cast<OpNode>(expr) != nullptr);
+            reds += (dynamic_pointer_cast<Reduce>(expr) != nullptr);
+        }
+        return pair<size_t, size_t>{ops, reds};
+    };
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    ASSERT_EQ(count_nodes(OpFusion::Build(chain("fusion_chain_nodes", in_sym))), (pair<size_t, size_t>{1, 1}));
+    ASSERT_EQ(count_nodes(OpFusion::Build(norm("fusion_norm_nodes", in_sym))), (pair<size_t, size_t>{1, 2}));
+    ASSERT_EQ(count_nodes(OpFusion::Build(window_avg("fusion_avg_nodes", in_sym))), (pair<size_t, size_t>{0, 1}));
+
+    // Operators without producers to fuse are unchanged
+    auto int_sym = _sym("in", tilt::Type(types::INT32, _iter(0, -1)));
+    auto sum_op = _MovingSum(int_sym, 1, 10);
+    ASSERT_EQ(OpFusion::Build(sum_op)->syms, sum_op->syms);
+
+    run_fusion_test("fusion_chain", chain, true);
+    run_fusion_test("fusion_norm", norm, false);
+    run_fusion_test("fusion_window_avg", window_avg, true);
+}
+
+static void run_sliding_test(string query_name, function<Op(string, _sym)> build, bool gaps, int64_t max_dur = 1)
+{
+    size_t len = 20000;
+
+    // Integral values keep the sums exact, whatever the order of updates.
+    // Events longer than the period span several updates of the window.
+    auto size = get_buf_size(2 * len);
+    auto in = make_input(0, len, gaps, [max_dur](size_t i) { return 1 + (i * 7) % max_dur; },
+                         [](size_t i) { return 3 + i % 13; });
+    region_t in_reg;
+    vector<ival_t> in_tl;
+    vector<float> in_data;
+    init_input(&in_reg, 0, size, in_tl, in_data, in);
+
+    auto in_sym = _sym("in", tilt::Type(types::FLOAT32, _iter(0, -1)));
+    auto op = build(query_name, in_sym);
+    auto ref_op = _Recompute(build(query_name + "_ref", in_sym));
+    auto end = in.et - in.et % op->iter.period;
+
+    // Reductions with an evict function get a loop evicting events
+    auto loop = LoopGen::Build(_sym(query_name, op), op.get());
+    auto evict_loops = count_if(loop->inner_loops.begin(), loop->inner_loops.end(),
+        [](const auto& l) { return l->name.find("_evict") != string::npos; });
+    ASSERT_GT(evict_loops, 0);
+
+    region_t ref_reg;
+    auto ref_tl = vector<ival_t>(size);
+    auto ref_data = vector<float>(size);
+    init_region(&ref_reg, 0, size, ref_tl.data(), reinterpret_cast<char*>(ref_data.data()));
+    run_op(query_name + "_ref", ref_op, 0, end, &ref_reg, &in_reg);
+
+    region_t out_reg;
+    auto out_tl = vector<ival_t>(size);
+    auto out_data = vector<float>(size);
+    init_region(&out_reg, 0, size, out_tl.data(), reinterpret_cast<char*>(out_data.data()));
+    run_op(query_name, op, 0, end, &out_reg, &in_reg);
+    assert_same_events(&out_reg, &ref_reg);
+}
+
+void sliding_window_test()
+{
+    auto avg = [](int64_t w, int64_t period) {
+        return [w, period](string name, _sym in) { return _SlidingAvg(name, in, w, period); };
+    };
+    auto var = [](int64_t w, int64_t period) {
+        return [w, period](string name, _sym in) { return _SlidingVar(name, in, w, period); };
+    };
+
+    run_sliding_test("sliding_avg", avg(100, 10), false);
+    run_sliding_test("sliding_avg_gaps", avg(100, 10), true);
+    run_sliding_test("sliding_avg_step", avg(1000, 1), false);
+    run_sliding_test("sliding_var", var(100, 10), false);
+    run_sliding_test("sliding_var_gaps", var(500, 20), true);
+    run_sliding_test("sliding_avg_long", avg(100, 10), false, 50);
+    run_sliding_test("sliding_var_long", var(500, 20), true, 70);
+}
@@ -2,6 +2,9 @@
 #include <cstdlib>
 #include <vector>
 #include <numeric>
+#include <algorithm>
+
+#include "tilt/engine/pipeline.h"
 
 #include "test_query.h"
 
@@ -20,16 +23,34 @@ Op _Select(_sym in, function<Expr(Expr)> sel_expr)
     return sel_op;
 }
 
+// Like `_Select`, but the expression gets the whole event
+Op _Map(_sym in, function<Expr(Expr)> map_expr)
+{
+    auto e = in[_pt(0)];
+    auto e_sym = _sym("e", e);
+    auto res = map_expr(e_sym);
+    auto res_sym = _sym("res", res);
+    auto map_op = _op(
+        _iter(0, 1),
+        Params{ in },
+        SymTable{ {e_sym, e}, {res_sym, res} },
+        _exists(e_sym),
+        res_sym);
+    return map_op;
+}
+
 Expr _Count(_sym win)
 {
     auto acc = [](Expr s, Expr st, Expr et, Expr d) { return _add(s, _f32(1)); };
-    return _red(win, _f32(0), acc);
+    auto evict = [](Expr s, Expr st, Expr et, Expr d) { return _sub(s, _f32(1)); };
+    return _red(win, _f32(0), acc, evict);
 }
 
 Expr _Sum(_sym win)
 {
     auto acc = [](Expr s, Expr st, Expr et, Expr d) { return _add(s, d); };
-    return _red(win, _f32(0), acc);
+    auto evict = [](Expr s, Expr st, Expr et, Expr d) { return _sub(s, d); };
+    return _red(win, _f32(0), acc, evict);
 }
 
 Op _WindowAvg(string query_name, _sym in, int64_t w)
@@ -112,7 +133,12 @@ Expr _Average(_sym win)
         auto count = _get(s, 1);
         return _new(vector<Expr>{_add(sum, d), _add(count, _f32(1))});
     };
-    return _red(win, _new(vector<Expr>{_f32(0), _f32(0)}), acc);
+    auto evict = [](Expr s, Expr st, Expr et, Expr d) {
+        auto sum = _get(s, 0);
+        auto count = _get(s, 1);
+        return _new(vector<Expr>{_sub(sum, d), _sub(count, _f32(1))});
+    };
+    return _red(win, _new(vector<Expr>{_f32(0), _f32(0)}), acc, evict);
 }
 
 Expr _StdDev(_sym win)
@@ -122,7 +148,80 @@ Expr _StdDev(_sym win)
         auto count = _get(s, 1);
         return _new(vector<Expr>{_add(sum, _mul(d, d)), _add(count, _f32(1))});
     };
-    return _red(win, _new(vector<Expr>{_f32(0), _f32(0)}), acc);
+    auto evict = [](Expr s, Expr st, Expr et, Expr d) {
+        auto sum = _get(s, 0);
+        auto count = _get(s, 1);
+        return _new(vector<Expr>{_sub(sum, _mul(d, d)), _sub(count, _f32(1))});
+    };
+    return _red(win, _new(vector<Expr>{_f32(0), _f32(0)}), acc, evict);
+}
+
+// State of (sum, sum of squares, count), from which the variance is
+// sum of squares / count - (sum / count)^2
+Expr _Variance(_sym win)
+{
+    auto acc = [](Expr s, Expr st, Expr et, Expr d) {
+        return _new(vector<Expr>{_add(_get(s, 0), d), _add(_get(s, 1), _mul(d, d)), _add(_get(s, 2), _f32(1))});
+    };
+    auto evict = [](Expr s, Expr st, Expr et, Expr d) {
+        return _new(vector<Expr>{_sub(_get(s, 0), d), _sub(_get(s, 1), _mul(d, d)), _sub(_get(s, 2), _f32(1))});
+    };
+    return _red(win, _new(vector<Expr>{_f32(0), _f32(0), _f32(0)}), acc, evict);
+}
+
+// Average of a window of `w` sliding by `period`, over non-empty windows
+Op _SlidingAvg(string query_name, _sym in, int64_t w, int64_t period)
+{
+    auto window = in[_win(-w, 0)];
+    auto window_sym = _sym("win", window);
+    auto count = _Count(window_sym);
+    auto count_sym = _sym(query_name + "_count", count);
+    auto sum = _Sum(window_sym);
+    auto sum_sym = _sym(query_name + "_sum", sum);
+    auto avg = sum_sym / count_sym;
+    auto avg_sym = _sym("avg", avg);
+    auto avg_op = _op(
+        _iter(0, period),
+        Params{ in },
+        SymTable{ {window_sym, window}, {count_sym, count}, {sum_sym, sum}, {avg_sym, avg} },
+        _gt(count_sym, _f32(0)),
+        avg_sym);
+    return avg_op;
+}
+
+// Variance of a window of `w` sliding by `period`, over non-empty windows
+Op _SlidingVar(string query_name, _sym in, int64_t w, int64_t period)
+{
+    auto window = in[_win(-w, 0)];
+    auto window_sym = _sym("win", window);
+    auto state = _Variance(window_sym);
+    auto state_sym = _sym(query_name + "_var_state", state);
+    auto count = _get(state_sym, 2);
+    auto mean = _div(_get(state_sym, 0), count);
+    auto var = _sub(_div(_get(state_sym, 1), count), _mul(mean, mean));
+    auto var_sym = _sym("var", var);
+    auto var_op = _op(
+        _iter(0, period),
+        Params{ in },
+        SymTable{ {window_sym, window}, {state_sym, state}, {var_sym, var} },
+        _gt(count, _f32(0)),
+        var_sym);
+    return var_op;
+}
+
+// Copy of an operator whose reductions are recomputed over their whole
+// window in every iteration rather than updated incrementally
+Op _Recompute(Op op)
+{
+    auto syms = op->syms;
+    for (auto& [sym, expr] : syms) {
+        if (auto red = dynamic_pointer_cast<Reduce>(expr)) {
+            expr = make_shared<Reduce>(red->lstream, red->state, red->acc, nullptr, red->args);
+        } else if (auto inner = dynamic_pointer_cast<OpNode>(expr)) {
+            expr = _Recompute(inner);
+        }
+    }
+    return make_shared<OpNode>(op->iter, op->inputs, syms, op->pred, op->output, op->aux);
 }
 
 Op _Norm(string query_name, _sym in, int64_t len)
@@ -173,6 +272,16 @@ Op _Norm(string query_name, _sym in, int64_t len)
     return query_op;
 }
 
+// `_Norm` split into a stage subtracting the window average from every
+// event and one dividing the result by the window standard deviation
+vector<Op> _NormStages(string query_name, _sym in, int64_t len)
+{
+    auto norm_op = _Norm(query_name, in, len);
+    auto avg_op = find_if(norm_op->syms.begin(), norm_op->syms.end(),
+                          [&](const auto& s) { return s.first->name == query_name + "_avgop"; });
+    return PipelineExecutor::Split(norm_op, { avg_op->first });
+}
+
 Op _MovingSum(_sym in, int64_t dur, int64_t w)
 {
     auto e = in[_pt(0)];